@@ -0,0 +1,256 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include "malloc.h"
+
+// Per-routine cost of the allocator internals over heaps of controlled shape.
+// Build with `make bench-internals`; optional arguments: zones block_size free%.
+// Blocks stay within SMALL_MAX_SIZE: LARGE zones come from the span pool,
+// which needs large_lock and its own release path.
+// Hardware counters come from perf_event_open and print as n/a when the
+// kernel or container does not allow them (see perf_event_paranoid).
+
+#define OPS 20000
+#define NCOUNTERS 4
+
+typedef struct {
+    const char *name;
+    double ns;
+    unsigned long long counts[NCOUNTERS];
+    unsigned long long ops;
+} t_result;
+
+static int g_group = -1;
+static int g_fds[NCOUNTERS];
+static unsigned long long g_ids[NCOUNTERS];
+static const unsigned long long g_configs[NCOUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+static void counters_open(void) {
+    for (int i = 0; i < NCOUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = g_configs[i];
+        attr.disabled = (i == 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+        g_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, g_group, 0);
+        if (g_fds[i] < 0) {
+            for (int j = 0; j < i; j++)
+                close(g_fds[j]);
+            g_group = -1;
+            return;
+        }
+        if (i == 0)
+            g_group = g_fds[0];
+        ioctl(g_fds[i], PERF_EVENT_IOC_ID, &g_ids[i]);
+    }
+}
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static long g_start;
+
+static void measure_start(void) {
+    if (g_group >= 0) {
+        ioctl(g_group, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(g_group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    g_start = now_ns();
+}
+
+static void measure_stop(t_result *result, unsigned long long ops) {
+    struct {
+        unsigned long long nr;
+        struct { unsigned long long value, id; } values[NCOUNTERS];
+    } data;
+
+    long end = now_ns();
+    result->ns += end - g_start;
+    result->ops += ops;
+    if (g_group < 0)
+        return;
+    ioctl(g_group, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if (read(g_group, &data, sizeof(data)) <= 0)
+        return;
+    for (unsigned long long v = 0; v < data.nr && v < NCOUNTERS; v++)
+        for (int i = 0; i < NCOUNTERS; i++)
+            if (data.values[v].id == g_ids[i])
+                result->counts[i] += data.values[v].value;
+}
+
+static void print_result(t_result *result) {
+    printf("  %-22s %9.1f", result->name, result->ns / result->ops);
+    for (int i = 0; i < NCOUNTERS; i++) {
+        if (g_group >= 0)
+            printf(" %10.1f", (double)result->counts[i] / result->ops);
+        else
+            printf(" %10s", "n/a");
+    }
+    printf("\n");
+}
+
+// Zones of block_size blocks, free_pct of them freed and coalesced
+static t_zone *build_heap(size_t nzones, size_t block_size, int free_pct,
+                          void **ptrs, size_t *nptrs, size_t max_ptrs) {
+    t_zone *head = NULL;
+    unsigned int seed = 42;
+
+    *nptrs = 0;
+    for (size_t z = 0; z < nzones; z++) {
+        t_zone *zone = create_zone(block_size);
+        if (!zone)
+            break;
+        zone->next = head;
+        head = zone;
+        t_block *block = zone->blocks;
+        while (block && block->size > block_size + sizeof(t_block) + 16) {
+            split_block(block, block_size);
+            block->free = 0;
+            block = block->next;
+        }
+        for (block = zone->blocks; block; block = block->next) {
+            if (block->free)
+                continue;
+            if ((int)(rand_r(&seed) % 100) < free_pct) {
+                block->free = 1;
+                merge_blocks(block);
+                if (block->prev && block->prev->free) {
+                    block = block->prev;
+                    merge_blocks(block);
+                }
+            } else if (*nptrs < max_ptrs) {
+                ptrs[(*nptrs)++] = (char *)block + sizeof(t_block);
+            }
+        }
+    }
+    return head;
+}
+
+static void destroy_heap(t_zone *zone) {
+    while (zone) {
+        t_zone *next = zone->next;
+        unmap_zone(zone);
+        zone = next;
+    }
+}
+
+static void run_shape(size_t nzones, size_t block_size, int free_pct) {
+    static void *ptrs[OPS];
+    static t_block *holes[OPS];
+    size_t nptrs;
+    volatile size_t sink = 0;
+    unsigned int seed = 7;
+
+    t_result find_hit = { "find_free_block hit", 0, {0}, 0 };
+    t_result find_miss = { "find_free_block miss", 0, {0}, 0 };
+    t_result split = { "split_block", 0, {0}, 0 };
+    t_result merge = { "merge_blocks", 0, {0}, 0 };
+    t_result lookup = { "get_block_from_ptr", 0, {0}, 0 };
+    t_result align = { "align_size", 0, {0}, 0 };
+    t_result create = { "create_zone", 0, {0}, 0 };
+
+    assert(block_size <= SMALL_MAX_SIZE);
+    t_zone *heap = build_heap(nzones, block_size, free_pct, ptrs, &nptrs, OPS);
+    printf("\n%zu zones, %zu-byte blocks, %d%% freed (%zu live sampled)\n",
+           nzones, block_size, free_pct, nptrs);
+
+    measure_start();
+    for (int i = 0; i < OPS; i++)
+        sink += (size_t)find_free_block(heap, block_size);
+    measure_stop(&find_hit, OPS);
+
+    measure_start();
+    for (int i = 0; i < OPS / 10; i++)
+        sink += (size_t)find_free_block(heap, SIZE_MAX / 2);
+    measure_stop(&find_miss, OPS / 10);
+
+    // Split then re-merge every free hole large enough to split
+    size_t nholes = 0;
+    for (t_zone *zone = heap; zone && nholes < OPS; zone = zone->next)
+        for (t_block *block = zone->blocks; block && nholes < OPS; block = block->next)
+            if (block->free && block->size > 2 * (16 + sizeof(t_block)))
+                holes[nholes++] = block;
+    for (int round = 0; nholes && round < 10; round++) {
+        measure_start();
+        for (size_t i = 0; i < nholes; i++)
+            split_block(holes[i], 16);
+        measure_stop(&split, nholes);
+        measure_start();
+        for (size_t i = 0; i < nholes; i++)
+            merge_blocks(holes[i]);
+        measure_stop(&merge, nholes);
+    }
+
+    if (nptrs) {
+        measure_start();
+        for (int i = 0; i < OPS; i++)
+            sink += (size_t)get_block_from_ptr(heap, ptrs[rand_r(&seed) % nptrs], NULL);
+        measure_stop(&lookup, OPS);
+    }
+
+    measure_start();
+    for (int i = 0; i < OPS; i++)
+        sink += align_size((size_t)i);
+    measure_stop(&align, OPS);
+
+    for (int i = 0; i < 100; i++) {
+        measure_start();
+        t_zone *zone = create_zone(block_size);
+        measure_stop(&create, 1);
+        if (zone)
+            unmap_zone(zone);
+    }
+
+    print_result(&find_hit);
+    print_result(&find_miss);
+    if (split.ops) {
+        print_result(&split);
+        print_result(&merge);
+    }
+    if (lookup.ops)
+        print_result(&lookup);
+    print_result(&align);
+    print_result(&create);
+    destroy_heap(heap);
+    (void)sink;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 3 && (size_t)atol(argv[2]) > SMALL_MAX_SIZE) {
+        fprintf(stderr, "%s: block_size must not exceed %d\n", argv[0], SMALL_MAX_SIZE);
+        return 1;
+    }
+    counters_open();
+    printf("  %-22s %9s %10s %10s %10s %10s\n", "routine", "ns/op",
+           "cycles", "instr", "cache-miss", "br-miss");
+    if (argc > 3) {
+        run_shape(atol(argv[1]), atol(argv[2]), atoi(argv[3]));
+        return 0;
+    }
+    size_t zones[] = { 1, 16, 128 };
+    size_t sizes[] = { 32, 512 };
+    int frees[] = { 0, 50, 90 };
+    for (size_t z = 0; z < sizeof(zones) / sizeof(*zones); z++)
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+            for (size_t f = 0; f < sizeof(frees) / sizeof(*frees); f++)
+                run_shape(zones[z], sizes[s], frees[f]);
+    return 0;
+}
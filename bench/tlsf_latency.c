@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <x86intrin.h>
+
+// Latency distribution of malloc/free across heap sizes.
+// Build with `make bench` (default allocator) or `make bench tlsf=true`.
+// Cycles are TSC ticks read around each call, including the rdtsc cost.
+
+#define OPS 50000
+#define MIN_SIZE 129
+#define MAX_SIZE 32768
+
+static long g_malloc_ns[OPS];
+static long g_free_ns[OPS];
+static long g_malloc_cycles[OPS];
+static long g_free_cycles[OPS];
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static size_t random_size(void) {
+    return MIN_SIZE + (size_t)rand() % (MAX_SIZE - MIN_SIZE + 1);
+}
+
+static int compare_long(const void *a, const void *b) {
+    long x = *(const long *)a;
+    long y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_distribution(const char *name, long *samples, long *cycles,
+                               size_t live) {
+    qsort(samples, OPS, sizeof(long), compare_long);
+    qsort(cycles, OPS, sizeof(long), compare_long);
+    printf("%-6s %8zu %10ld %10ld %10ld %10ld %10ld %10ld %10ld\n", name, live,
+           samples[OPS / 2], samples[OPS * 99 / 100],
+           samples[OPS * 999 / 1000], samples[OPS - 1],
+           cycles[OPS / 2], cycles[OPS * 999 / 1000], cycles[OPS - 1]);
+}
+
+static void run(size_t live) {
+    void **ptrs = calloc(live, sizeof(void *));
+    if (!ptrs) return;
+    
+    // Build a fragmented heap: fill it, then free every third block
+    for (size_t i = 0; i < live; i++) {
+        ptrs[i] = malloc(random_size());
+    }
+    for (size_t i = 0; i < live; i += 3) {
+        free(ptrs[i]);
+        ptrs[i] = malloc(random_size() / 2 + MIN_SIZE);
+    }
+    
+    // Timed steady state: replace a random live block per iteration
+    for (int op = 0; op < OPS; op++) {
+        size_t i = (size_t)rand() % live;
+        size_t size = random_size();
+        long start = now_ns();
+        unsigned long long c0 = __rdtsc();
+        free(ptrs[i]);
+        unsigned long long c1 = __rdtsc();
+        long mid = now_ns();
+        unsigned long long c2 = __rdtsc();
+        ptrs[i] = malloc(size);
+        unsigned long long c3 = __rdtsc();
+        long end = now_ns();
+        g_free_ns[op] = mid - start;
+        g_malloc_ns[op] = end - mid;
+        g_free_cycles[op] = (long)(c1 - c0);
+        g_malloc_cycles[op] = (long)(c3 - c2);
+    }
+    
+    print_distribution("malloc", g_malloc_ns, g_malloc_cycles, live);
+    print_distribution("free", g_free_ns, g_free_cycles, live);
+    for (size_t i = 0; i < live; i++) {
+        free(ptrs[i]);
+    }
+    free(ptrs);
+}
+
+int main(void) {
+    size_t heap_sizes[] = {256, 1024, 4096, 16384};
+    
+    srand(42);
+    printf("%-6s %8s %10s %10s %10s %10s %10s %10s %10s\n", "op", "live", "p50 ns",
+           "p99 ns", "p99.9 ns", "max ns", "p50 cyc", "p99.9 cyc", "max cyc");
+    for (size_t i = 0; i < sizeof(heap_sizes) / sizeof(heap_sizes[0]); i++) {
+        run(heap_sizes[i]);
+    }
+    return 0;
+}
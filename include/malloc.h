@@ -2,6 +2,7 @@
 # define MALLOC_H
 
 # include <unistd.h>
+# include <stdint.h>
 # include <sys/mman.h>
 # include <pthread.h>
 
@@ -10,48 +11,400 @@
 
 # define TINY_ZONE_SIZE (getpagesize() * 4)
 # define SMALL_ZONE_SIZE (getpagesize() * 16)
+# define HEAP_ZONE_SIZE (getpagesize() * 16)
+
+# define TLSF_SL_LOG2 4
+# define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+# define TLSF_FL_SHIFT (TLSF_SL_LOG2 + 4)
+# define TLSF_FL_MAX 30
+# define TLSF_FL_COUNT (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+# define TLSF_MAX_SIZE (1UL << (TLSF_FL_MAX - 1))
+# define TLSF_POOL_SIZE (getpagesize() * 256)
+
+# define CACHE_LINE_SIZE 64
+# define MALLOC_MAX_REQUEST (SIZE_MAX >> 1)
+# define ZONE_COLORS 8
+# define ZONE_INDEX_BUCKETS 24
+
+# define SHM_HEAP_MAGIC 0x5348eab1U
+# define SHM_HEAP_VERSION 1
+# define SHM_HEAP_HEADER_SIZE ((sizeof(t_shm_heap) + 15) & ~15)
+
+# define PHEAP_MAGIC 0x50484541U
+# define PHEAP_VERSION 1
+
+# define STATS_MAGIC 0x5354a7e5U
+# define STATS_SHARDS 16
+# define STATS_PATH "/dev/shm/malloc_stats."
+
+# define SPAN_TREE_SIZE 0
+# define SPAN_TREE_ADDR 1
+# define SPAN_MAX_SIZE (getpagesize() * 256)
+# define SPAN_POOL_MAX ((size_t)getpagesize() * 4096)
+# define SPAN_MAX_AGE 1024
+# define SPAN_SWEEP_INTERVAL 64
+
+# define MEMLIMIT_HIGH_WATER(limit) ((limit) - ((limit) >> 3))
+
+# define LOCK_SPIN_COUNT 100
+
+# define PERCPU_CLASSES (SMALL_MAX_SIZE / 16)
+# define PERCPU_SLOTS 32
+
+# define BLOCK_MAGIC 0xb10c0000U
+# define BLOCK_MAGIC_MASK 0xffff0000U
+# define BLOCK_TINY 1
+# define BLOCK_SMALL 2
+# define BLOCK_LARGE 3
+# define BLOCK_HEAP 4
+# define BLOCK_TLSF 5
+# define BLOCK_SHM 6
+# define BLOCK_PHEAP 7
+# define BLOCK_SLACK_SHIFT 8
+# define BLOCK_SLACK_MASK 0xff00U
+# define BLOCK_CACHED 0x80U
+# define BLOCK_CLASS(tag) ((tag) & 0x7fU)
+# define BLOCK_IS(tag, class) (((tag) & ~(BLOCK_SLACK_MASK | BLOCK_CACHED)) \
+    == (BLOCK_MAGIC | (class)))
+
+# define DUMP_MAGIC 0x504d444dU
+# define DUMP_VERSION 1
+# define DUMP_CLASS_SPAN 8
+# define DUMP_BLOCK_CACHED 2
+
+# define OBJCACHE_SLAB_SIZE (getpagesize() * 16)
+# define OBJCACHE_MAGAZINE_SIZE 32
+# define OBJCACHE_MAX_CPUS 256
+
+typedef struct s_lock {
+    pthread_mutex_t mutex;
+    size_t          contended;
+} t_lock;
 
 typedef struct s_block {
     size_t          size;
     int             free;
+    unsigned int    tag;
     struct s_block  *next;
     struct s_block  *prev;
 } t_block;
 
 typedef struct s_zone {
     size_t          size;
+    size_t          color;
+    size_t          free_bytes;
+    size_t          largest_free;
+    int             bucket;
     struct s_zone   *next;
+    struct s_zone   *index_next;
+    struct s_zone   *index_prev;
     struct s_block  *blocks;
 } t_zone;
 
+# define ZONE_HEADER_SIZE ((sizeof(t_zone) + 15) & ~15)
+# define ZONE_OVERHEAD(color) (((color) + ZONE_HEADER_SIZE + sizeof(t_block) \
+    + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1))
+
+typedef struct s_magazine {
+    pthread_mutex_t lock;
+    size_t          count;
+    void            *objs[OBJCACHE_MAGAZINE_SIZE];
+} __attribute__((aligned(64))) t_magazine;
+
+typedef struct s_objcache {
+    size_t              size;
+    size_t              align;
+    size_t              slab_size;
+    void                (*ctor)(void *);
+    void                (*dtor)(void *);
+    t_zone              *slabs;
+    size_t              nslabs;
+    pthread_mutex_t     mutex;
+    struct s_objcache   *next;
+    size_t              ncpus;
+    t_magazine          *magazines;
+} t_objcache;
+
+typedef struct s_objslab {
+    t_objcache      *cache;
+    char            *objs;
+    size_t          capacity;
+    size_t          nfree;
+    unsigned int    free_idx[];
+} t_objslab;
+
+typedef struct s_tlsf {
+    unsigned int    fl_bitmap;
+    unsigned int    sl_bitmap[TLSF_FL_COUNT];
+    t_block         *free[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    t_zone          *pools;
+} t_tlsf;
+
+typedef struct s_percpu_slot {
+    size_t          top;
+    void            *objs[PERCPU_SLOTS];
+} t_percpu_slot;
+
+typedef struct s_percpu {
+    t_percpu_slot   *slots;
+    int             *drain;
+    size_t          ncpus;
+    int             state;
+} t_percpu;
+
+// Block and heap headers of a shared segment: links are byte offsets from
+// the start of the segment, 0 meaning none, so that every process can map
+// it at a different address.
+typedef struct s_shm_block {
+    size_t          size;
+    size_t          next;
+    size_t          prev;
+    int             free;
+    unsigned int    tag;
+} t_shm_block;
+
+typedef struct s_shm_heap {
+    unsigned int    magic;
+    unsigned int    version;
+    size_t          size;
+    size_t          blocks;
+    pthread_mutex_t mutex;
+} t_shm_heap;
+
+// Lives in the payload of the first block of a persistent heap file, at
+// ZONE_OVERHEAD(0) from its start.
+typedef struct s_pheap {
+    unsigned int    magic;
+    unsigned int    version;
+    t_zone          *zone;
+    size_t          size;
+    void            *root;
+    int             fd;
+    int             state;
+} t_pheap;
+
+// Shared stats page (MALLOC_STATS=1), read by malloc-top. Allocation, free
+// and contention counts are monotonic, the first two sharded per CPU;
+// footprint, zones and pools form a snapshot guarded by seq, which is odd
+// while a writer is inside.
+typedef struct s_stats_shard {
+    size_t          allocs[3];
+    size_t          frees;
+} __attribute__((aligned(CACHE_LINE_SIZE))) t_stats_shard;
+
+typedef struct s_stats {
+    unsigned int    magic;
+    unsigned int    seq;
+    int             pid;
+    size_t          footprint;
+    size_t          zones[3];
+    size_t          pools;
+    size_t          contended;
+    t_stats_shard   shards[STATS_SHARDS];
+} t_stats;
+
+// Header written at the start of a pooled LARGE span. Each span sits in two
+// treaps sharing prio: one ordered by (size, address) for best fit, one by
+// address for coalescing.
+typedef struct s_span {
+    size_t          size;
+    size_t          stamp;
+    unsigned int    prio;
+    struct s_span   *child[2][2];
+    struct s_span   *victim;
+} t_span;
+
+typedef struct s_span_pool {
+    t_span          *root[2];
+    size_t          bytes;
+    size_t          clock;
+    size_t          swept;
+    unsigned int    seed;
+} t_span_pool;
+
+// Binary heap dump (malloc_dump): one t_dump_header, then for every zone a
+// t_dump_zone followed by its nblocks t_dump_block records. slack is the
+// block size minus the requested size, 255 when it did not fit the tag; free
+// is DUMP_BLOCK_CACHED for blocks parked in a per-CPU cache.
+typedef struct s_dump_header {
+    unsigned int    magic;
+    unsigned int    version;
+    size_t          pagesize;
+    size_t          tiny_max;
+    size_t          small_max;
+    size_t          tiny_zone;
+    size_t          small_zone;
+    size_t          zone_overhead;
+    size_t          block_header;
+    int             isolate;
+    size_t          zones;
+    size_t          blocks;
+} t_dump_header;
+
+typedef struct s_dump_zone {
+    size_t          addr;
+    size_t          size;
+    unsigned int    class;
+    unsigned int    color;
+    size_t          nblocks;
+} t_dump_zone;
+
+typedef struct s_dump_block {
+    size_t          offset;
+    size_t          size;
+    unsigned int    free;
+    unsigned int    slack;
+} t_dump_block;
+
+typedef struct s_memlimit {
+    size_t          footprint;
+    size_t          hard;
+    size_t          soft;
+    size_t          threshold;
+    int             state;
+    int             aggressive;
+    int             purge;
+} t_memlimit;
+
 typedef struct s_malloc {
     t_zone          *tiny;
     t_zone          *small;
     t_zone          *large;
+    t_zone          *index[3][ZONE_INDEX_BUCKETS];
+    t_zone          *retained[2];
+    t_objcache      *caches;
+    t_tlsf          tlsf;
+    t_percpu        percpu;
+    t_span_pool     spans;
+    t_memlimit      limit;
+    t_stats         *stats;
+    t_lock          tiny_lock;
+    t_lock          small_lock;
+    t_lock          large_lock;
+    size_t          zone_color;
+    int             isolate;
     pthread_mutex_t mutex;
 } t_malloc;
 
+typedef struct s_heap {
+    t_zone          *zones;
+    t_block         *cursor;
+} t_heap;
+
 // Global variables
 extern t_malloc g_malloc;
 
 // Core functions
 void    *malloc(size_t size);
 void    free(void *ptr);
+void    free_to_zone(void *ptr);
 void    *realloc(void *ptr, size_t size);
 
 // Memory management functions
 void    *allocate_memory(size_t size);
 t_zone  *create_zone(size_t size);
+t_zone  *map_zone(size_t zone_size, size_t color);
+t_zone  *init_zone(char *base, size_t zone_size, size_t color);
+void    unmap_zone(t_zone *zone);
 t_block *find_free_block(t_zone *zone, size_t size);
+t_block *find_zone_block(t_zone *zone, size_t size);
 void    split_block(t_block *block, size_t size);
 void    merge_blocks(t_block *block);
 
+// Zone summary index functions (per-class buckets by largest free block)
+void    zone_index_insert(t_zone *zone);
+void    zone_index_remove(t_zone *zone);
+void    zone_refresh(t_zone *zone);
+t_zone  *zone_index_find(int class, size_t size);
+t_block *zone_find_block(int class, size_t size, t_zone **zone);
+void    zone_take_block(t_zone *zone, t_block *block, size_t size);
+t_block *zone_release_block(t_zone *zone, t_block *block);
+void    zone_absorb_next(t_zone *zone, t_block *block);
+
+// LARGE span pool functions (called with large_lock held)
+char    *span_take(size_t *size);
+int     span_release(t_zone *zone);
+void    span_purge(void);
+
+// Memory limit functions (rlimits, cgroup v2 memory.max, soft cap)
+void    memlimit_map(size_t size);
+void    memlimit_unmap(size_t size);
+int     memlimit_pressure(void);
+void    memlimit_purge(void);
+void    memlimit_discard(t_block *block);
+void    release_zone(t_zone *zone);
+void    malloc_set_soft_limit(size_t bytes);
+size_t  malloc_footprint(void);
+
+// Stats page functions (hot paths check g_malloc.stats first)
+void    stats_init(void);
+void    stats_alloc(size_t size);
+void    stats_free(void);
+void    stats_zones(int class, long delta);
+void    stats_footprint(void);
+void    stats_contended(void);
+
+// Locking functions (spin briefly, then park on the mutex)
+void    lock_acquire(t_lock *lock);
+void    lock_release(t_lock *lock);
+t_lock  *lock_block_from_ptr(void *ptr, t_block **block, t_zone **zone);
+
+// TLSF functions (SMALL and LARGE when built with MALLOC_TLSF)
+void    *tlsf_malloc(size_t size);
+void    tlsf_free(t_block *block);
+int     tlsf_extend(t_block *block, size_t size);
+t_block *tlsf_get_block(void *ptr);
+
+// Per-CPU cache functions (Linux rseq, TINY and SMALL)
+void    percpu_init(void);
+void    *percpu_malloc(size_t size);
+int     percpu_free(void *ptr);
+void    percpu_drain(void);
+int     percpu_cpu(void);
+
+// Private heap functions (caller-owned, not thread-safe)
+t_heap  *heap_create(void);
+void    *heap_malloc(t_heap *heap, size_t size);
+void    heap_free(t_heap *heap, void *ptr);
+void    heap_destroy(t_heap *heap);
+
+// Shared-memory heap functions (memfd segment, process-shared)
+t_shm_heap  *shm_heap_create(size_t size, int *fd);
+t_shm_heap  *shm_heap_attach(int fd);
+void        shm_heap_detach(t_shm_heap *heap);
+void        *shm_heap_malloc(t_shm_heap *heap, size_t size);
+void        shm_heap_free(t_shm_heap *heap, void *ptr);
+size_t      shm_heap_offset(t_shm_heap *heap, void *ptr);
+void        *shm_heap_ptr(t_shm_heap *heap, size_t offset);
+
+// Persistent heap functions (file-backed, caller-owned, not thread-safe)
+t_pheap *pheap_open(const char *path, size_t size, void *base);
+void    *pheap_malloc(t_pheap *heap, size_t size);
+void    pheap_free(t_pheap *heap, void *ptr);
+void    pheap_set_root(t_pheap *heap, void *root);
+void    *pheap_get_root(t_pheap *heap);
+int     pheap_sync(t_pheap *heap);
+void    pheap_close(t_pheap *heap);
+
+// Object cache functions
+t_objcache  *objcache_create(size_t size, size_t align,
+                void (*ctor)(void *), void (*dtor)(void *));
+void        *objcache_alloc(t_objcache *cache);
+void        objcache_free(t_objcache *cache, void *obj);
+void        objcache_destroy(t_objcache *cache);
+
 // Display functions
 void    show_alloc_mem(void);
+int     malloc_dump(const char *path);
 
 // Utility functions
 size_t  align_size(size_t size);
+int     get_class_for_size(size_t size);
+t_zone  **get_class_zones(int class);
+t_lock  *get_class_lock(int class);
 t_zone  *get_zone_for_size(size_t size);
-t_block *get_block_from_ptr(void *ptr);
+t_block *get_block_from_ptr(t_zone *zone, void *ptr, t_zone **owner);
+void    block_set_slack(t_block *block, size_t request);
+int     cacheline_isolation(void);
 
 #endif 
\ No newline at end of file
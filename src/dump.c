@@ -0,0 +1,166 @@
+#include "malloc.h"
+#include "../libft/includes/libft.h"
+#include <fcntl.h>
+
+// malloc_dump writes records through a stack buffer with write(2) so that
+// it never allocates, taking one class lock at a time. Blocks parked in the
+// per-CPU cache are recorded as DUMP_BLOCK_CACHED; private, persistent and
+// shared heaps belong to their callers and are not included.
+
+typedef struct s_dump_out {
+	int		fd;
+	size_t	len;
+	int		error;
+	size_t	zones;
+	size_t	blocks;
+	char	buf[4096];
+}	t_dump_out;
+
+static void	dump_flush(t_dump_out *out)
+{
+	size_t	done;
+	ssize_t	ret;
+
+	done = 0;
+	while (!out->error && done < out->len)
+	{
+		ret = write(out->fd, out->buf + done, out->len - done);
+		if (ret <= 0)
+			out->error = 1;
+		else
+			done += ret;
+	}
+	out->len = 0;
+}
+
+static void	dump_put(t_dump_out *out, const void *data, size_t size)
+{
+	if (out->len + size > sizeof(out->buf))
+		dump_flush(out);
+	ft_memcpy(out->buf + out->len, data, size);
+	out->len += size;
+}
+
+static void	dump_zone(t_dump_out *out, t_zone *zone, unsigned int class)
+{
+	t_dump_zone		record;
+	t_dump_block	entry;
+	t_block			*block;
+	unsigned int	tag;
+
+	record.addr = (size_t)zone - zone->color;
+	record.size = zone->size;
+	record.class = class;
+	record.color = zone->color;
+	record.nblocks = 0;
+	block = zone->blocks;
+	while (block)
+	{
+		record.nblocks++;
+		block = block->next;
+	}
+	dump_put(out, &record, sizeof(record));
+	block = zone->blocks;
+	while (block)
+	{
+		entry.offset = (char *)block - (char *)record.addr;
+		entry.size = block->size;
+		tag = __atomic_load_n(&block->tag, __ATOMIC_RELAXED);
+		entry.free = block->free != 0;
+		if (!block->free && (tag & BLOCK_CACHED))
+			entry.free = DUMP_BLOCK_CACHED;
+		entry.slack = (tag & BLOCK_SLACK_MASK) >> BLOCK_SLACK_SHIFT;
+		dump_put(out, &entry, sizeof(entry));
+		block = block->next;
+	}
+	out->zones++;
+	out->blocks += record.nblocks;
+}
+
+static void	dump_spans(t_dump_out *out, t_span *span)
+{
+	t_dump_zone		record;
+	t_dump_block	entry;
+
+	if (!span)
+		return ;
+	dump_spans(out, span->child[SPAN_TREE_ADDR][0]);
+	record.addr = (size_t)span;
+	record.size = span->size;
+	record.class = DUMP_CLASS_SPAN;
+	record.color = 0;
+	record.nblocks = 1;
+	dump_put(out, &record, sizeof(record));
+	entry.offset = 0;
+	entry.size = span->size;
+	entry.free = 1;
+	entry.slack = 0;
+	dump_put(out, &entry, sizeof(entry));
+	out->zones++;
+	out->blocks++;
+	dump_spans(out, span->child[SPAN_TREE_ADDR][1]);
+}
+
+static void	dump_header(t_dump_header *header, t_dump_out *out)
+{
+	ft_memset(header, 0, sizeof(*header));
+	header->magic = DUMP_MAGIC;
+	header->version = DUMP_VERSION;
+	header->pagesize = getpagesize();
+	header->tiny_max = TINY_MAX_SIZE;
+	header->small_max = SMALL_MAX_SIZE;
+	header->tiny_zone = TINY_ZONE_SIZE;
+	header->small_zone = SMALL_ZONE_SIZE;
+	header->zone_overhead = ZONE_OVERHEAD(0);
+	header->block_header = sizeof(t_block);
+	header->isolate = cacheline_isolation();
+	header->zones = out->zones;
+	header->blocks = out->blocks;
+}
+
+int	malloc_dump(const char *path)
+{
+	t_dump_out		out;
+	t_dump_header	header;
+	t_zone			*zone;
+	int				class;
+
+	out.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (out.fd < 0)
+		return (-1);
+	out.len = 0;
+	out.error = 0;
+	out.zones = 0;
+	out.blocks = 0;
+	dump_header(&header, &out);
+	dump_put(&out, &header, sizeof(header));
+	class = BLOCK_TINY;
+	while (class <= BLOCK_LARGE)
+	{
+		lock_acquire(get_class_lock(class));
+		zone = *get_class_zones(class);
+		while (zone)
+		{
+			dump_zone(&out, zone, class);
+			zone = zone->next;
+		}
+		if (class == BLOCK_LARGE)
+			dump_spans(&out, g_malloc.spans.root[SPAN_TREE_ADDR]);
+		lock_release(get_class_lock(class));
+		class++;
+	}
+	lock_acquire(&g_malloc.small_lock);
+	zone = g_malloc.tlsf.pools;
+	while (zone)
+	{
+		dump_zone(&out, zone, BLOCK_TLSF);
+		zone = zone->next;
+	}
+	lock_release(&g_malloc.small_lock);
+	dump_flush(&out);
+	dump_header(&header, &out);
+	if (pwrite(out.fd, &header, sizeof(header), 0) != sizeof(header))
+		out.error = 1;
+	close(out.fd);
+	return (out.error ? -1 : 0);
+}
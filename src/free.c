@@ -1,31 +1,98 @@
 #include "malloc.h"
 
-void	free(void *ptr)
+void	release_zone(t_zone *zone)
+{
+	t_zone	**link;
+	int		class;
+
+	class = BLOCK_CLASS(zone->blocks->tag);
+	link = get_class_zones(class);
+	while (*link && *link != zone)
+		link = &(*link)->next;
+	if (*link)
+		*link = zone->next;
+	if (class != BLOCK_LARGE && g_malloc.retained[class - BLOCK_TINY] == zone)
+		g_malloc.retained[class - BLOCK_TINY] = NULL;
+	zone_index_remove(zone);
+	if (class != BLOCK_LARGE || !span_release(zone))
+		unmap_zone(zone);
+	stats_zones(class, -1);
+}
+
+// Keeps one empty TINY and one empty SMALL zone mapped so that a class
+// oscillating around a zone boundary does not mmap/munmap on every call.
+static int	retain_zone(t_zone *zone)
+{
+	t_zone	**retained;
+	int		class;
+
+	class = BLOCK_CLASS(zone->blocks->tag);
+	if (class == BLOCK_LARGE || memlimit_pressure())
+		return (0);
+	retained = &g_malloc.retained[class - BLOCK_TINY];
+	if (*retained && *retained != zone
+		&& (*retained)->blocks->free && !(*retained)->blocks->next)
+		return (0);
+	*retained = zone;
+	return (1);
+}
+
+// True when every block in use is parked in a per-CPU cache: the zone can
+// only be released once a drain has brought those blocks back.
+static int	zone_only_cached(t_zone *zone)
+{
+	t_block	*block;
+
+	block = zone->blocks;
+	while (block && (block->free
+			|| (__atomic_load_n(&block->tag, __ATOMIC_RELAXED) & BLOCK_CACHED)))
+		block = block->next;
+	return (!block);
+}
+
+// Returns a block to its zone under the class lock, bypassing the per-CPU
+// cache; used by free and by the per-CPU drain.
+void	free_to_zone(void *ptr)
 {
+	t_lock	*lock;
 	t_block	*block;
 	t_zone	*zone;
 
-	if (!ptr)
+	lock = lock_block_from_ptr(ptr, &block, &zone);
+	if (!lock)
 		return ;
-	pthread_mutex_lock(&g_malloc.mutex);
-	block = get_block_from_ptr(ptr);
-	if (!block)
+#ifdef MALLOC_TLSF
+	if (!zone)
 	{
-		pthread_mutex_unlock(&g_malloc.mutex);
+		tlsf_free(block);
+		lock_release(lock);
 		return ;
 	}
-	block->free = 1;
-	merge_blocks(block);
-	zone = get_zone_for_size(block->size);
-	if (zone && zone->blocks->free && !zone->blocks->next)
+#endif
+	block = zone_release_block(zone, block);
+	if (zone->blocks->free && !zone->blocks->next)
 	{
-		if (block->size <= TINY_MAX_SIZE)
-			g_malloc.tiny = zone->next;
-		else if (block->size <= SMALL_MAX_SIZE)
-			g_malloc.small = zone->next;
-		else
-			g_malloc.large = zone->next;
-		munmap(zone, zone->size);
+		if (!retain_zone(zone))
+			release_zone(zone);
 	}
-	pthread_mutex_unlock(&g_malloc.mutex);
-} 
\ No newline at end of file
+	else
+	{
+		if (memlimit_pressure())
+			memlimit_discard(block);
+		if (g_malloc.percpu.state == 1 && zone_only_cached(zone))
+			percpu_drain();
+	}
+	lock_release(lock);
+}
+
+void	free(void *ptr)
+{
+	if (!ptr)
+		return ;
+	if (__atomic_load_n(&g_malloc.stats, __ATOMIC_ACQUIRE))
+		stats_free();
+	if (percpu_free(ptr))
+		return ;
+	free_to_zone(ptr);
+	memlimit_purge();
+}
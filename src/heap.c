@@ -0,0 +1,92 @@
+#include "malloc.h"
+
+static t_zone	*heap_add_zone(t_heap *heap, size_t size)
+{
+	t_zone	*zone;
+	size_t	zone_size;
+
+	zone_size = size + ZONE_OVERHEAD(0);
+	if (zone_size < (size_t)HEAP_ZONE_SIZE)
+		zone_size = HEAP_ZONE_SIZE;
+	zone = map_zone(zone_size, 0);
+	if (!zone)
+		return (NULL);
+	zone->blocks->tag = BLOCK_MAGIC | BLOCK_HEAP;
+	zone->next = heap->zones;
+	heap->zones = zone;
+	return (zone);
+}
+
+t_heap	*heap_create(void)
+{
+	t_heap	*heap;
+	t_heap	tmp;
+	t_block	*block;
+
+	tmp.zones = NULL;
+	tmp.cursor = NULL;
+	if (!heap_add_zone(&tmp, 0))
+		return (NULL);
+	block = tmp.zones->blocks;
+	split_block(block, align_size(sizeof(t_heap)));
+	block->free = 0;
+	heap = (t_heap *)((char *)block + sizeof(t_block));
+	heap->zones = tmp.zones;
+	heap->cursor = block->next;
+	return (heap);
+}
+
+void	*heap_malloc(t_heap *heap, size_t size)
+{
+	t_zone	*zone;
+	t_block	*block;
+
+	if (!heap || size == 0 || size > MALLOC_MAX_REQUEST)
+		return (NULL);
+	size = align_size(size);
+	block = heap->cursor;
+	if (!block || block->size < size)
+	{
+		zone = heap_add_zone(heap, size);
+		if (!zone)
+			return (NULL);
+		block = zone->blocks;
+	}
+	split_block(block, size);
+	block->free = 0;
+	if (block == heap->cursor || !heap->cursor
+		|| (block->next && block->next->size > heap->cursor->size))
+		heap->cursor = block->next;
+	return ((void *)((char *)block + sizeof(t_block)));
+}
+
+void	heap_free(t_heap *heap, void *ptr)
+{
+	t_block	*block;
+
+	if (!heap || !ptr)
+		return ;
+	block = (t_block *)((char *)ptr - sizeof(t_block));
+	block->free = 1;
+	if (block->next && block->next == heap->cursor)
+	{
+		merge_blocks(block);
+		heap->cursor = block;
+	}
+}
+
+void	heap_destroy(t_heap *heap)
+{
+	t_zone	*zone;
+	t_zone	*next;
+
+	if (!heap)
+		return ;
+	zone = heap->zones;
+	while (zone)
+	{
+		next = zone->next;
+		unmap_zone(zone);
+		zone = next;
+	}
+}
@@ -0,0 +1,30 @@
+#include "malloc.h"
+
+static void	cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+void	lock_acquire(t_lock *lock)
+{
+	int	spin;
+
+	spin = 0;
+	while (spin < LOCK_SPIN_COUNT)
+	{
+		if (pthread_mutex_trylock(&lock->mutex) == 0)
+			return ;
+		cpu_relax();
+		spin++;
+	}
+	pthread_mutex_lock(&lock->mutex);
+	lock->contended++;
+	stats_contended();
+}
+
+void	lock_release(t_lock *lock)
+{
+	pthread_mutex_unlock(&lock->mutex);
+}
@@ -1,51 +1,84 @@
 #include "malloc.h"
 
-void	*malloc(size_t size)
+static void	*malloc_from_class(int class, size_t size, size_t request)
 {
+	t_zone	**zones;
 	t_zone	*zone;
 	t_block	*block;
-	void	*ptr;
 
-	if (size == 0)
-		return (NULL);
-	pthread_mutex_lock(&g_malloc.mutex);
-	size = align_size(size);
-	zone = get_zone_for_size(size);
-	block = find_free_block(zone, size);
-	if (block)
-	{
-		split_block(block, size);
-		block->free = 0;
-		ptr = (void *)((char *)block + sizeof(t_block));
-	}
-	else
+	block = zone_find_block(class, size, &zone);
+	if (!block)
 	{
 		zone = create_zone(size);
 		if (!zone)
-		{
-			pthread_mutex_unlock(&g_malloc.mutex);
 			return (NULL);
-		}
-		if (size <= TINY_MAX_SIZE)
-		{
-			zone->next = g_malloc.tiny;
-			g_malloc.tiny = zone;
-		}
-		else if (size <= SMALL_MAX_SIZE)
-		{
-			zone->next = g_malloc.small;
-			g_malloc.small = zone;
-		}
-		else
-		{
-			zone->next = g_malloc.large;
-			g_malloc.large = zone;
-		}
+		zones = get_class_zones(class);
+		zone->next = *zones;
+		*zones = zone;
+		zone_index_insert(zone);
+		stats_zones(class, 1);
 		block = zone->blocks;
-		split_block(block, size);
-		block->free = 0;
-		ptr = (void *)((char *)block + sizeof(t_block));
 	}
-	pthread_mutex_unlock(&g_malloc.mutex);
+	zone_take_block(zone, block, size);
+	block_set_slack(block, request);
+	return ((void *)((char *)block + sizeof(t_block)));
+}
+
+// Called with the block's lock held, or on a block popped from this CPU's
+// cache that no other thread can reach.
+static void	*with_slack(void *ptr, size_t request)
+{
+	if (ptr)
+		block_set_slack((t_block *)((char *)ptr - sizeof(t_block)), request);
 	return (ptr);
-} 
\ No newline at end of file
+}
+
+static void	*count_alloc(void *ptr, size_t size)
+{
+	if (ptr && __atomic_load_n(&g_malloc.stats, __ATOMIC_ACQUIRE))
+		stats_alloc(size);
+	return (ptr);
+}
+
+void	*malloc(size_t size)
+{
+	t_lock	*lock;
+	void	*ptr;
+	size_t	request;
+	int		class;
+
+	if (size == 0 || size > MALLOC_MAX_REQUEST)
+		return (NULL);
+	request = size;
+	size = align_size(size);
+	ptr = with_slack(percpu_malloc(size), request);
+	if (ptr)
+		return (count_alloc(ptr, size));
+	if (!__atomic_load_n(&g_malloc.percpu.state, __ATOMIC_ACQUIRE))
+	{
+		pthread_mutex_lock(&g_malloc.mutex);
+		if (!g_malloc.percpu.state)
+		{
+			stats_init();
+			percpu_init();
+		}
+		pthread_mutex_unlock(&g_malloc.mutex);
+	}
+	memlimit_purge();
+#ifdef MALLOC_TLSF
+	if (size > TINY_MAX_SIZE)
+	{
+		lock_acquire(&g_malloc.small_lock);
+		ptr = with_slack(tlsf_malloc(size), request);
+		lock_release(&g_malloc.small_lock);
+		if (ptr)
+			return (count_alloc(ptr, size));
+	}
+#endif
+	class = get_class_for_size(size);
+	lock = get_class_lock(class);
+	lock_acquire(lock);
+	ptr = malloc_from_class(class, size, request);
+	lock_release(lock);
+	return (count_alloc(ptr, size));
+}
@@ -0,0 +1,216 @@
+#include "malloc.h"
+#include <sys/resource.h>
+#include <stdint.h>
+#include <fcntl.h>
+
+// The limit is the smallest of RLIMIT_AS, RLIMIT_DATA and the cgroup v2
+// memory.max of the calling process, read once on the first mapping. When
+// the bytes mapped by the allocator reach MEMLIMIT_HIGH_WATER of it, or the
+// soft cap set through malloc_set_soft_limit, the allocator turns aggressive:
+// empty zones are unmapped instead of retained, the per-CPU cache is
+// bypassed and drained, TLSF pools stop growing geometrically and the
+// interior pages of every free block are handed back with MADV_DONTNEED.
+
+static size_t	read_file(const char *path, char *buf, size_t size)
+{
+	int		fd;
+	ssize_t	len;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return (0);
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len < 0)
+		len = 0;
+	buf[len] = '\0';
+	return (len);
+}
+
+static size_t	append(char *dst, size_t len, size_t size, const char *src)
+{
+	while (*src && *src != '\n' && len + 1 < size)
+		dst[len++] = *src++;
+	dst[len] = '\0';
+	return (len);
+}
+
+static size_t	cgroup_limit(void)
+{
+	char	buf[512];
+	char	path[512];
+	char	*line;
+	size_t	len;
+	size_t	limit;
+
+	if (!read_file("/proc/self/cgroup", buf, sizeof(buf)))
+		return (0);
+	line = buf;
+	while (*line && !(line[0] == '0' && line[1] == ':' && line[2] == ':'))
+	{
+		while (*line && *line != '\n')
+			line++;
+		if (*line)
+			line++;
+	}
+	if (!*line)
+		return (0);
+	len = append(path, 0, sizeof(path), "/sys/fs/cgroup");
+	len = append(path, len, sizeof(path), line + 3);
+	append(path, len, sizeof(path), "/memory.max");
+	if (!read_file(path, buf, sizeof(buf)))
+		return (0);
+	limit = 0;
+	line = buf;
+	while (*line >= '0' && *line <= '9')
+		limit = limit * 10 + (*line++ - '0');
+	return (limit);
+}
+
+static size_t	rlimit_value(int resource)
+{
+	struct rlimit	rl;
+
+	if (getrlimit(resource, &rl) || rl.rlim_cur == RLIM_INFINITY)
+		return (0);
+	return (rl.rlim_cur);
+}
+
+static size_t	min_limit(size_t a, size_t b)
+{
+	if (!a || (b && b < a))
+		return (b);
+	return (a);
+}
+
+static void	set_threshold(void)
+{
+	t_memlimit	*limit;
+	size_t		threshold;
+	size_t		soft;
+
+	limit = &g_malloc.limit;
+	threshold = SIZE_MAX;
+	if (limit->hard)
+		threshold = MEMLIMIT_HIGH_WATER(limit->hard);
+	soft = __atomic_load_n(&limit->soft, __ATOMIC_RELAXED);
+	if (soft && soft < threshold)
+		threshold = soft;
+	__atomic_store_n(&limit->threshold, threshold, __ATOMIC_RELAXED);
+}
+
+static void	memlimit_update(void)
+{
+	t_memlimit	*limit;
+	int			aggressive;
+
+	limit = &g_malloc.limit;
+	if (!__atomic_load_n(&limit->state, __ATOMIC_ACQUIRE))
+	{
+		limit->hard = min_limit(min_limit(rlimit_value(RLIMIT_AS),
+					rlimit_value(RLIMIT_DATA)), cgroup_limit());
+		set_threshold();
+		__atomic_store_n(&limit->state, 1, __ATOMIC_RELEASE);
+	}
+	aggressive = __atomic_load_n(&limit->footprint, __ATOMIC_RELAXED)
+		>= __atomic_load_n(&limit->threshold, __ATOMIC_RELAXED);
+	if (!aggressive)
+		__atomic_store_n(&limit->aggressive, 0, __ATOMIC_RELAXED);
+	else if (!__atomic_exchange_n(&limit->aggressive, 1, __ATOMIC_RELAXED))
+		__atomic_store_n(&limit->purge, 1, __ATOMIC_RELAXED);
+}
+
+void	memlimit_map(size_t size)
+{
+	__atomic_add_fetch(&g_malloc.limit.footprint, size, __ATOMIC_RELAXED);
+	memlimit_update();
+	stats_footprint();
+}
+
+void	memlimit_unmap(size_t size)
+{
+	__atomic_sub_fetch(&g_malloc.limit.footprint, size, __ATOMIC_RELAXED);
+	memlimit_update();
+	stats_footprint();
+}
+
+int	memlimit_pressure(void)
+{
+	return (__atomic_load_n(&g_malloc.limit.aggressive, __ATOMIC_RELAXED));
+}
+
+void	memlimit_discard(t_block *block)
+{
+	size_t	page;
+	size_t	start;
+	size_t	end;
+
+	page = getpagesize();
+	start = ((size_t)block + sizeof(t_block) + 16 + page - 1) & ~(page - 1);
+	end = ((size_t)block + sizeof(t_block) + block->size) & ~(page - 1);
+	if (start < end)
+		madvise((void *)start, end - start, MADV_DONTNEED);
+}
+
+static void	purge_zones(t_zone *zone, int release)
+{
+	t_zone	*next;
+	t_block	*block;
+
+	while (zone)
+	{
+		next = zone->next;
+		if (release && zone->blocks->free && !zone->blocks->next)
+			release_zone(zone);
+		else
+		{
+			block = zone->blocks;
+			while (block)
+			{
+				if (block->free)
+					memlimit_discard(block);
+				block = block->next;
+			}
+		}
+		zone = next;
+	}
+}
+
+// Called with no lock held: takes each class lock in turn, never nested.
+void	memlimit_purge(void)
+{
+	t_lock	*lock;
+	int		class;
+
+	if (!__atomic_load_n(&g_malloc.limit.purge, __ATOMIC_RELAXED)
+		|| !__atomic_exchange_n(&g_malloc.limit.purge, 0, __ATOMIC_RELAXED))
+		return ;
+	percpu_drain();
+	class = BLOCK_TINY;
+	while (class <= BLOCK_LARGE)
+	{
+		lock = get_class_lock(class);
+		lock_acquire(lock);
+		purge_zones(*get_class_zones(class), 1);
+		if (class == BLOCK_LARGE)
+			span_purge();
+		lock_release(lock);
+		class++;
+	}
+	lock_acquire(&g_malloc.small_lock);
+	purge_zones(g_malloc.tlsf.pools, 0);
+	lock_release(&g_malloc.small_lock);
+}
+
+void	malloc_set_soft_limit(size_t bytes)
+{
+	__atomic_store_n(&g_malloc.limit.soft, bytes, __ATOMIC_RELAXED);
+	set_threshold();
+	memlimit_update();
+	memlimit_purge();
+}
+
+size_t	malloc_footprint(void)
+{
+	return (__atomic_load_n(&g_malloc.limit.footprint, __ATOMIC_RELAXED));
+}
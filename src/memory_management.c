@@ -1,51 +1,140 @@
 #include "malloc.h"
-#include <sys/resource.h>
+#include <stdlib.h>
 
-t_malloc	g_malloc = {NULL, NULL, NULL, PTHREAD_MUTEX_INITIALIZER};
+t_malloc	g_malloc = {
+	.tiny_lock = {PTHREAD_MUTEX_INITIALIZER, 0},
+	.small_lock = {PTHREAD_MUTEX_INITIALIZER, 0},
+	.large_lock = {PTHREAD_MUTEX_INITIALIZER, 0},
+	.mutex = PTHREAD_MUTEX_INITIALIZER
+};
+
+int	cacheline_isolation(void)
+{
+	char	*env;
+	int		isolate;
+
+	isolate = __atomic_load_n(&g_malloc.isolate, __ATOMIC_RELAXED);
+	if (!isolate)
+	{
+		env = getenv("MALLOC_CACHELINE_ISOLATE");
+		isolate = (env && *env == '1') ? 2 : 1;
+		__atomic_store_n(&g_malloc.isolate, isolate, __ATOMIC_RELAXED);
+	}
+	return (isolate == 2);
+}
 
 size_t	align_size(size_t size)
 {
+	if (cacheline_isolation())
+		return (((size + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1))
+			+ CACHE_LINE_SIZE - sizeof(t_block));
 	return ((size + 15) & ~15);
 }
 
 t_zone	*create_zone(size_t size)
 {
 	t_zone	*zone;
+	char	*base;
 	size_t	zone_size;
+	size_t	color;
 
+	color = 0;
+	if (size <= SMALL_MAX_SIZE)
+		color = (__atomic_fetch_add(&g_malloc.zone_color, 1, __ATOMIC_RELAXED)
+				% ZONE_COLORS) * CACHE_LINE_SIZE;
 	if (size <= TINY_MAX_SIZE)
 		zone_size = TINY_ZONE_SIZE;
 	else if (size <= SMALL_MAX_SIZE)
 		zone_size = SMALL_ZONE_SIZE;
 	else
-		zone_size = size + sizeof(t_zone) + sizeof(t_block);
-	zone = mmap(NULL, zone_size, PROT_READ | PROT_WRITE,
+		zone_size = (size + ZONE_OVERHEAD(0) + getpagesize() - 1)
+			& ~((size_t)getpagesize() - 1);
+	base = NULL;
+	if (size > SMALL_MAX_SIZE)
+		base = span_take(&zone_size);
+	if (base)
+		zone = init_zone(base, zone_size, 0);
+	else
+		zone = map_zone(zone_size, color);
+	if (!zone)
+		return (NULL);
+	if (size <= TINY_MAX_SIZE)
+		zone->blocks->tag = BLOCK_MAGIC | BLOCK_TINY;
+	else if (size <= SMALL_MAX_SIZE)
+		zone->blocks->tag = BLOCK_MAGIC | BLOCK_SMALL;
+	else
+		zone->blocks->tag = BLOCK_MAGIC | BLOCK_LARGE;
+	return (zone);
+}
+
+t_zone	*map_zone(size_t zone_size, size_t color)
+{
+	char	*base;
+
+	base = mmap(NULL, zone_size, PROT_READ | PROT_WRITE,
 			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-	if (zone == MAP_FAILED)
+	if (base == MAP_FAILED)
 		return (NULL);
+	memlimit_map(zone_size);
+	return (init_zone(base, zone_size, color));
+}
+
+t_zone	*init_zone(char *base, size_t zone_size, size_t color)
+{
+	t_zone	*zone;
+	size_t	offset;
+
+	zone = (t_zone *)(base + color);
 	zone->size = zone_size;
+	zone->color = color;
 	zone->next = NULL;
-	zone->blocks = (t_block *)((char *)zone + sizeof(t_zone));
-	zone->blocks->size = zone_size - sizeof(t_zone) - sizeof(t_block);
+	zone->index_next = NULL;
+	zone->index_prev = NULL;
+	zone->bucket = -1;
+	offset = ZONE_OVERHEAD(color) - sizeof(t_block);
+	zone->blocks = (t_block *)(base + offset);
+	zone->blocks->size = zone_size - offset - sizeof(t_block);
+	zone->free_bytes = zone->blocks->size;
+	zone->largest_free = zone->blocks->size;
 	zone->blocks->free = 1;
+	zone->blocks->tag = BLOCK_MAGIC;
 	zone->blocks->next = NULL;
 	zone->blocks->prev = NULL;
 	return (zone);
 }
 
+void	unmap_zone(t_zone *zone)
+{
+	size_t	size;
+
+	size = zone->size;
+	munmap((char *)zone - zone->color, size);
+	memlimit_unmap(size);
+}
+
+t_block	*find_zone_block(t_zone *zone, size_t size)
+{
+	t_block	*block;
+
+	block = zone->blocks;
+	while (block)
+	{
+		if (block->free && block->size >= size)
+			return (block);
+		block = block->next;
+	}
+	return (NULL);
+}
+
 t_block	*find_free_block(t_zone *zone, size_t size)
 {
 	t_block	*block;
 
 	while (zone)
 	{
-		block = zone->blocks;
-		while (block)
-		{
-			if (block->free && block->size >= size)
-				return (block);
-			block = block->next;
-		}
+		block = find_zone_block(zone, size);
+		if (block)
+			return (block);
 		zone = zone->next;
 	}
 	return (NULL);
@@ -62,6 +151,7 @@ void	split_block(t_block *block, size_t size)
 	new_block = (t_block *)((char *)block + sizeof(t_block) + size);
 	new_block->size = remaining_size;
 	new_block->free = 1;
+	new_block->tag = block->tag & ~(BLOCK_SLACK_MASK | BLOCK_CACHED);
 	new_block->next = block->next;
 	new_block->prev = block;
 	if (block->next)
@@ -81,51 +171,130 @@ void	merge_blocks(t_block *block)
 	}
 }
 
-t_zone	*get_zone_for_size(size_t size)
+int	get_class_for_size(size_t size)
 {
 	if (size <= TINY_MAX_SIZE)
-		return (g_malloc.tiny);
+		return (BLOCK_TINY);
 	else if (size <= SMALL_MAX_SIZE)
-		return (g_malloc.small);
-	return (g_malloc.large);
+		return (BLOCK_SMALL);
+	return (BLOCK_LARGE);
 }
 
-t_block	*get_block_from_ptr(void *ptr)
+t_zone	**get_class_zones(int class)
+{
+	if (class == BLOCK_TINY)
+		return (&g_malloc.tiny);
+	else if (class == BLOCK_SMALL)
+		return (&g_malloc.small);
+	return (&g_malloc.large);
+}
+
+t_lock	*get_class_lock(int class)
+{
+	if (class == BLOCK_TINY)
+		return (&g_malloc.tiny_lock);
+	else if (class == BLOCK_SMALL)
+		return (&g_malloc.small_lock);
+	return (&g_malloc.large_lock);
+}
+
+t_zone	*get_zone_for_size(size_t size)
+{
+	return (*get_class_zones(get_class_for_size(size)));
+}
+
+t_block	*get_block_from_ptr(t_zone *zone, void *ptr, t_zone **owner)
 {
-	t_zone	*zone;
 	t_block	*block;
 
-	zone = g_malloc.tiny;
 	while (zone)
 	{
-		block = zone->blocks;
-		while (block)
+		if ((char *)ptr > (char *)zone
+			&& (char *)ptr < (char *)zone - zone->color + zone->size)
 		{
-			if ((char *)block + sizeof(t_block) == ptr)
-				return (block);
-			block = block->next;
+			block = zone->blocks;
+			while (block)
+			{
+				if ((char *)block + sizeof(t_block) == ptr)
+				{
+					if (owner)
+						*owner = zone;
+					return (block);
+				}
+				block = block->next;
+			}
+			return (NULL);
 		}
 		zone = zone->next;
 	}
-	zone = g_malloc.small;
-	while (zone)
+	return (NULL);
+}
+
+// The class the block's tag claims, or 0 when the header may sit on the
+// previous page and cannot be read safely.
+static int	get_class_hint(void *ptr)
+{
+	t_block	*block;
+	int		class;
+
+	if ((size_t)ptr & 15)
+		return (BLOCK_TINY);
+	if (((size_t)ptr & (getpagesize() - 1)) < sizeof(t_block))
+		return (0);
+	block = (t_block *)((char *)ptr - sizeof(t_block));
+	if ((block->tag & BLOCK_MAGIC_MASK) != BLOCK_MAGIC)
+		return (BLOCK_TINY);
+	class = BLOCK_CLASS(block->tag);
+	if (class == BLOCK_TLSF)
+		return (class);
+	if (class < BLOCK_TINY || class > BLOCK_LARGE)
+		return (BLOCK_TINY);
+	return (class);
+}
+
+t_lock	*lock_block_from_ptr(void *ptr, t_block **block, t_zone **zone)
+{
+	t_lock	*lock;
+	int		hint;
+	int		class;
+	int		i;
+
+	*zone = NULL;
+	hint = get_class_hint(ptr);
+#ifdef MALLOC_TLSF
+	if (!hint || hint == BLOCK_TLSF)
 	{
-		block = zone->blocks;
-		while (block)
-		{
-			if ((char *)block + sizeof(t_block) == ptr)
-				return (block);
-			block = block->next;
-		}
-		zone = zone->next;
+		lock_acquire(&g_malloc.small_lock);
+		*block = tlsf_get_block(ptr);
+		if (*block)
+			return (&g_malloc.small_lock);
+		lock_release(&g_malloc.small_lock);
 	}
-	zone = g_malloc.large;
-	while (zone)
+#endif
+	if (!hint || hint == BLOCK_TLSF)
+		hint = BLOCK_TINY;
+	i = 0;
+	while (i < 3)
 	{
-		block = zone->blocks;
-		if ((char *)block + sizeof(t_block) == ptr)
-			return (block);
-		zone = zone->next;
+		class = (hint - BLOCK_TINY + i) % 3 + BLOCK_TINY;
+		lock = get_class_lock(class);
+		lock_acquire(lock);
+		*block = get_block_from_ptr(*get_class_zones(class), ptr, zone);
+		if (*block)
+			return (lock);
+		lock_release(lock);
+		i++;
 	}
 	return (NULL);
-} 
\ No newline at end of file
+}
+
+void	block_set_slack(t_block *block, size_t request)
+{
+	size_t	slack;
+
+	slack = block->size - request;
+	if (slack > BLOCK_SLACK_MASK >> BLOCK_SLACK_SHIFT)
+		slack = BLOCK_SLACK_MASK >> BLOCK_SLACK_SHIFT;
+	__atomic_store_n(&block->tag, (block->tag & ~BLOCK_SLACK_MASK)
+		| (unsigned int)(slack << BLOCK_SLACK_SHIFT), __ATOMIC_RELAXED);
+}
@@ -0,0 +1,275 @@
+#define _GNU_SOURCE
+#include "malloc.h"
+#include <sched.h>
+
+static size_t	round_up(size_t n, size_t align)
+{
+	return ((n + align - 1) & ~(align - 1));
+}
+
+static t_zone	*map_aligned_zone(size_t size)
+{
+	char	*raw;
+	char	*aligned;
+	t_zone	*zone;
+
+	raw = mmap(NULL, size * 2, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED)
+		return (NULL);
+	aligned = (char *)round_up((size_t)raw, size);
+	if (aligned > raw)
+		munmap(raw, aligned - raw);
+	if (aligned + size < raw + size * 2)
+		munmap(aligned + size, raw + size * 2 - (aligned + size));
+	memlimit_map(size);
+	zone = (t_zone *)aligned;
+	zone->size = size;
+	zone->color = 0;
+	zone->next = NULL;
+	zone->blocks = NULL;
+	return (zone);
+}
+
+static t_objslab	*get_slab(t_zone *zone)
+{
+	return ((t_objslab *)((char *)zone + ZONE_HEADER_SIZE));
+}
+
+static t_zone	*slab_create(t_objcache *cache)
+{
+	t_zone		*zone;
+	t_objslab	*slab;
+	size_t		i;
+
+	zone = map_aligned_zone(cache->slab_size);
+	if (!zone)
+		return (NULL);
+	slab = get_slab(zone);
+	slab->cache = cache;
+	slab->capacity = (cache->slab_size - ZONE_HEADER_SIZE - sizeof(t_objslab))
+		/ (cache->size + sizeof(unsigned int));
+	slab->objs = (char *)round_up((size_t)&slab->free_idx[slab->capacity],
+			cache->align);
+	while (slab->objs + slab->capacity * cache->size
+		> (char *)zone + cache->slab_size)
+	{
+		slab->capacity--;
+		slab->objs = (char *)round_up(
+				(size_t)&slab->free_idx[slab->capacity], cache->align);
+	}
+	if (slab->capacity == 0)
+	{
+		munmap(zone, cache->slab_size);
+		memlimit_unmap(cache->slab_size);
+		return (NULL);
+	}
+	slab->nfree = slab->capacity;
+	i = 0;
+	while (i < slab->capacity)
+	{
+		slab->free_idx[i] = slab->capacity - 1 - i;
+		if (cache->ctor)
+			cache->ctor(slab->objs + i * cache->size);
+		i++;
+	}
+	zone->next = cache->slabs;
+	cache->slabs = zone;
+	cache->nslabs++;
+	return (zone);
+}
+
+static void	slab_release(t_objcache *cache, t_zone *zone)
+{
+	t_zone		**link;
+	t_objslab	*slab;
+	size_t		i;
+
+	link = &cache->slabs;
+	while (*link && *link != zone)
+		link = &(*link)->next;
+	if (*link)
+		*link = zone->next;
+	cache->nslabs--;
+	slab = get_slab(zone);
+	i = 0;
+	while (cache->dtor && i < slab->capacity)
+		cache->dtor(slab->objs + i++ * cache->size);
+	munmap(zone, zone->size);
+	memlimit_unmap(cache->slab_size);
+}
+
+static void	*slab_pop(t_objcache *cache)
+{
+	t_zone		*zone;
+	t_objslab	*slab;
+
+	zone = cache->slabs;
+	while (zone && get_slab(zone)->nfree == 0)
+		zone = zone->next;
+	if (!zone)
+		zone = slab_create(cache);
+	if (!zone)
+		return (NULL);
+	slab = get_slab(zone);
+	slab->nfree--;
+	return (slab->objs + slab->free_idx[slab->nfree] * cache->size);
+}
+
+static void	slab_push(t_objcache *cache, void *obj)
+{
+	t_zone		*zone;
+	t_objslab	*slab;
+
+	zone = (t_zone *)((size_t)obj & ~(cache->slab_size - 1));
+	slab = get_slab(zone);
+	slab->free_idx[slab->nfree++] = ((char *)obj - slab->objs) / cache->size;
+	if (slab->nfree == slab->capacity && cache->nslabs > 1)
+		slab_release(cache, zone);
+}
+
+// Smallest power-of-two slab that holds eight objects, or 0 when the object
+// is too large for the slab and its aligned mapping to be sized without
+// overflow. Slabs stay below MALLOC_MAX_REQUEST / 2 so that the doubled
+// mapping in map_aligned_zone cannot wrap either.
+static size_t	slab_size_for(size_t size, size_t align)
+{
+	size_t	overhead;
+	size_t	need;
+	size_t	slab;
+
+	overhead = ZONE_HEADER_SIZE + sizeof(t_objslab) + align;
+	if (size > (MALLOC_MAX_REQUEST / 4 - overhead) / 8 - sizeof(unsigned int))
+		return (0);
+	need = overhead + 8 * (size + sizeof(unsigned int));
+	slab = OBJCACHE_SLAB_SIZE;
+	while (slab < need)
+		slab *= 2;
+	return (slab);
+}
+
+static t_magazine	*get_magazine(t_objcache *cache)
+{
+	int	cpu;
+
+	cpu = sched_getcpu();
+	if (cpu < 0)
+		cpu = 0;
+	return (&cache->magazines[(size_t)cpu % cache->ncpus]);
+}
+
+t_objcache	*objcache_create(size_t size, size_t align,
+		void (*ctor)(void *), void (*dtor)(void *))
+{
+	t_objcache	*cache;
+	long		ncpus;
+	size_t		map_size;
+	size_t		i;
+
+	if (align < 16)
+		align = 16;
+	if (size == 0 || size > MALLOC_MAX_REQUEST || (align & (align - 1))
+		|| align > MALLOC_MAX_REQUEST / 16
+		|| !slab_size_for(round_up(size, align), align))
+		return (NULL);
+	ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (ncpus < 1)
+		ncpus = 1;
+	if (ncpus > OBJCACHE_MAX_CPUS)
+		ncpus = OBJCACHE_MAX_CPUS;
+	map_size = round_up(sizeof(t_objcache) + 64
+			+ ncpus * sizeof(t_magazine), getpagesize());
+	cache = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (cache == MAP_FAILED)
+		return (NULL);
+	cache->size = round_up(size, align);
+	cache->align = align;
+	cache->slab_size = slab_size_for(cache->size, align);
+	cache->ctor = ctor;
+	cache->dtor = dtor;
+	cache->slabs = NULL;
+	cache->nslabs = 0;
+	pthread_mutex_init(&cache->mutex, NULL);
+	cache->ncpus = ncpus;
+	cache->magazines = (t_magazine *)round_up(
+			(size_t)cache + sizeof(t_objcache), 64);
+	i = 0;
+	while (i < cache->ncpus)
+	{
+		pthread_mutex_init(&cache->magazines[i].lock, NULL);
+		cache->magazines[i++].count = 0;
+	}
+	pthread_mutex_lock(&g_malloc.mutex);
+	cache->next = g_malloc.caches;
+	g_malloc.caches = cache;
+	pthread_mutex_unlock(&g_malloc.mutex);
+	return (cache);
+}
+
+void	*objcache_alloc(t_objcache *cache)
+{
+	t_magazine	*mag;
+	void		*obj;
+
+	if (!cache)
+		return (NULL);
+	mag = get_magazine(cache);
+	pthread_mutex_lock(&mag->lock);
+	if (mag->count == 0)
+	{
+		pthread_mutex_lock(&cache->mutex);
+		while (mag->count < OBJCACHE_MAGAZINE_SIZE / 2
+			&& (obj = slab_pop(cache)))
+			mag->objs[mag->count++] = obj;
+		pthread_mutex_unlock(&cache->mutex);
+	}
+	obj = NULL;
+	if (mag->count)
+		obj = mag->objs[--mag->count];
+	pthread_mutex_unlock(&mag->lock);
+	return (obj);
+}
+
+void	objcache_free(t_objcache *cache, void *obj)
+{
+	t_magazine	*mag;
+
+	if (!cache || !obj)
+		return ;
+	mag = get_magazine(cache);
+	pthread_mutex_lock(&mag->lock);
+	if (mag->count == OBJCACHE_MAGAZINE_SIZE)
+	{
+		pthread_mutex_lock(&cache->mutex);
+		while (mag->count > OBJCACHE_MAGAZINE_SIZE / 2)
+			slab_push(cache, mag->objs[--mag->count]);
+		pthread_mutex_unlock(&cache->mutex);
+	}
+	mag->objs[mag->count++] = obj;
+	pthread_mutex_unlock(&mag->lock);
+}
+
+void	objcache_destroy(t_objcache *cache)
+{
+	t_objcache	**link;
+	size_t		i;
+
+	if (!cache)
+		return ;
+	pthread_mutex_lock(&g_malloc.mutex);
+	link = &g_malloc.caches;
+	while (*link && *link != cache)
+		link = &(*link)->next;
+	if (*link)
+		*link = cache->next;
+	pthread_mutex_unlock(&g_malloc.mutex);
+	while (cache->slabs)
+		slab_release(cache, cache->slabs);
+	i = 0;
+	while (i < cache->ncpus)
+		pthread_mutex_destroy(&cache->magazines[i++].lock);
+	pthread_mutex_destroy(&cache->mutex);
+	munmap(cache, round_up(sizeof(t_objcache) + 64
+			+ cache->ncpus * sizeof(t_magazine), getpagesize()));
+}
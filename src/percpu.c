@@ -0,0 +1,301 @@
+#define _GNU_SOURCE
+#include "malloc.h"
+#include <stdlib.h>
+
+#if defined(__x86_64__) && defined(__linux__) && __has_include(<sys/rseq.h>)
+# include <sys/rseq.h>
+# define PERCPU_RSEQ 1
+# pragma weak __rseq_offset
+# pragma weak __rseq_size
+#endif
+
+#ifdef PERCPU_RSEQ
+
+// Each critical section registers its descriptor (3) in rseq_cs, checks that
+// the thread still runs on the CPU whose slot it indexes, and commits with a
+// single store to slot->top before label 2. Preemption, migration or a signal
+// inside [1, 2) makes the kernel restart the thread at the abort handler (4),
+// whose preceding four bytes must be RSEQ_SIG.
+
+# define PERCPU_RSEQ_START \
+	".pushsection __rseq_cs, \"aw\"\n\t" \
+	".balign 32\n\t" \
+	"3:\n\t" \
+	".long 0x0, 0x0\n\t" \
+	".quad 1f, (2f - 1f), 4f\n\t" \
+	".popsection\n\t" \
+	".pushsection __rseq_cs_ptr_array, \"aw\"\n\t" \
+	".quad 3b\n\t" \
+	".popsection\n\t" \
+	"leaq 3b(%%rip), %%rax\n\t" \
+	"movq %%rax, %[rseq_cs]\n\t" \
+	"1:\n\t" \
+	"cmpl %[cpu], %[cpu_id]\n\t" \
+	"jnz 4f\n\t"
+
+# define PERCPU_RSEQ_ABORT \
+	".pushsection __rseq_failure, \"ax\"\n\t" \
+	".byte 0x0f, 0xb9, 0x3d\n\t" \
+	".long 0x53053053\n\t" \
+	"4:\n\t" \
+	"jmp %l[abort]\n\t" \
+	".popsection\n\t"
+
+static struct rseq	*get_rseq(void)
+{
+	return ((struct rseq *)((char *)__builtin_thread_pointer()
+		+ __rseq_offset));
+}
+
+static int	rseq_push(struct rseq *rs, t_percpu_slot *slot, int cpu, void *obj)
+{
+	__asm__ goto (
+		PERCPU_RSEQ_START
+		"movq %[top], %%rax\n\t"
+		"cmpq %[slots], %%rax\n\t"
+		"jae %l[full]\n\t"
+		"movq %[obj], (%[objs], %%rax, 8)\n\t"
+		"incq %%rax\n\t"
+		"movq %%rax, %[top]\n\t"
+		"2:\n\t"
+		PERCPU_RSEQ_ABORT
+		:
+		: [rseq_cs] "m" (rs->rseq_cs), [cpu_id] "m" (rs->cpu_id),
+		[cpu] "r" (cpu), [top] "m" (slot->top), [objs] "r" (slot->objs),
+		[obj] "r" (obj), [slots] "i" (PERCPU_SLOTS)
+		: "memory", "cc", "rax"
+		: abort, full);
+	return (1);
+abort:
+	return (-1);
+full:
+	return (0);
+}
+
+static int	rseq_pop(struct rseq *rs, t_percpu_slot *slot, int cpu, void **obj)
+{
+	__asm__ goto (
+		PERCPU_RSEQ_START
+		"movq %[top], %%rax\n\t"
+		"testq %%rax, %%rax\n\t"
+		"jz %l[empty]\n\t"
+		"decq %%rax\n\t"
+		"movq (%[objs], %%rax, 8), %%rcx\n\t"
+		"movq %%rcx, (%[obj])\n\t"
+		"movq %%rax, %[top]\n\t"
+		"2:\n\t"
+		PERCPU_RSEQ_ABORT
+		:
+		: [rseq_cs] "m" (rs->rseq_cs), [cpu_id] "m" (rs->cpu_id),
+		[cpu] "r" (cpu), [top] "m" (slot->top), [objs] "r" (slot->objs),
+		[obj] "r" (obj)
+		: "memory", "cc", "rax", "rcx"
+		: abort, empty);
+	return (1);
+abort:
+	return (-1);
+empty:
+	return (0);
+}
+
+static t_percpu_slot	*get_slot(int cpu, size_t size)
+{
+	if (size < 16)
+		return (NULL);
+	if (size > SMALL_MAX_SIZE)
+		size = SMALL_MAX_SIZE;
+	return (&g_malloc.percpu.slots[(size_t)cpu * PERCPU_CLASSES
+		+ size / 16 - 1]);
+}
+
+void	percpu_init(void)
+{
+	char	*env;
+	long	ncpus;
+	void	*slots;
+	int		state;
+
+	state = -1;
+	env = getenv("MALLOC_PERCPU");
+	ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	if ((!env || *env != '0') && &__rseq_size && __rseq_size > 0
+		&& (int)get_rseq()->cpu_id >= 0 && ncpus > 0)
+	{
+		slots = mmap(NULL, ncpus * (PERCPU_CLASSES * sizeof(t_percpu_slot)
+					+ sizeof(int)), PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (slots != MAP_FAILED)
+		{
+			g_malloc.percpu.slots = slots;
+			g_malloc.percpu.drain = (int *)(g_malloc.percpu.slots
+					+ ncpus * PERCPU_CLASSES);
+			g_malloc.percpu.ncpus = ncpus;
+			state = 1;
+		}
+	}
+	__atomic_store_n(&g_malloc.percpu.state, state, __ATOMIC_RELEASE);
+}
+
+// Parked blocks keep free == 0 so that no zone walk can hand them out or
+// coalesce them; BLOCK_CACHED tells the walks that only report on blocks to
+// treat them as not in use.
+static void	*uncache(void *obj)
+{
+	__atomic_fetch_and(&((t_block *)obj - 1)->tag, ~BLOCK_CACHED,
+		__ATOMIC_RELAXED);
+	return (obj);
+}
+
+// Slots may only be touched through rseq from their own CPU, so a drain is
+// a request: each CPU empties its slots into their zones on its next
+// percpu_malloc or percpu_free. A migration part way through hands the rest
+// back to the CPU that was left.
+static void	drain_cpu(struct rseq *rs, int cpu)
+{
+	void	*obj;
+	size_t	class;
+	int		ret;
+
+	class = 0;
+	while (class < PERCPU_CLASSES)
+	{
+		if ((int)__atomic_load_n(&rs->cpu_id_start, __ATOMIC_RELAXED) != cpu)
+		{
+			__atomic_store_n(&g_malloc.percpu.drain[cpu], 1, __ATOMIC_RELAXED);
+			return ;
+		}
+		ret = rseq_pop(rs, &g_malloc.percpu.slots[(size_t)cpu
+				* PERCPU_CLASSES + class], cpu, &obj);
+		if (ret > 0)
+			free_to_zone(uncache(obj));
+		else if (ret == 0)
+			class++;
+	}
+}
+
+static void	drain_requested(struct rseq *rs)
+{
+	int	cpu;
+
+	cpu = __atomic_load_n(&rs->cpu_id_start, __ATOMIC_RELAXED);
+	if ((size_t)cpu < g_malloc.percpu.ncpus
+		&& __atomic_load_n(&g_malloc.percpu.drain[cpu], __ATOMIC_RELAXED)
+		&& __atomic_exchange_n(&g_malloc.percpu.drain[cpu], 0,
+			__ATOMIC_RELAXED))
+		drain_cpu(rs, cpu);
+}
+
+void	percpu_drain(void)
+{
+	size_t	cpu;
+
+	if (__atomic_load_n(&g_malloc.percpu.state, __ATOMIC_ACQUIRE) != 1)
+		return ;
+	cpu = 0;
+	while (cpu < g_malloc.percpu.ncpus)
+		__atomic_store_n(&g_malloc.percpu.drain[cpu++], 1, __ATOMIC_RELAXED);
+}
+
+void	*percpu_malloc(size_t size)
+{
+	struct rseq		*rs;
+	t_percpu_slot	*slot;
+	void			*obj;
+	int				cpu;
+	int				ret;
+
+	if (size > SMALL_MAX_SIZE
+		|| __atomic_load_n(&g_malloc.percpu.state, __ATOMIC_ACQUIRE) != 1)
+		return (NULL);
+	rs = get_rseq();
+	drain_requested(rs);
+	ret = -1;
+	while (ret < 0)
+	{
+		cpu = __atomic_load_n(&rs->cpu_id_start, __ATOMIC_RELAXED);
+		if ((size_t)cpu >= g_malloc.percpu.ncpus)
+			return (NULL);
+		slot = get_slot(cpu, size);
+		if (!slot)
+			return (NULL);
+		ret = rseq_pop(rs, slot, cpu, &obj);
+	}
+	if (!ret)
+		return (NULL);
+	return (uncache(obj));
+}
+
+int	percpu_free(void *ptr)
+{
+	struct rseq		*rs;
+	t_percpu_slot	*slot;
+	t_block			*block;
+	int				cpu;
+	int				ret;
+
+	if (__atomic_load_n(&g_malloc.percpu.state, __ATOMIC_ACQUIRE) != 1)
+		return (0);
+	rs = get_rseq();
+	drain_requested(rs);
+	if (memlimit_pressure() || ((size_t)ptr & 15)
+		|| ((size_t)ptr & (getpagesize() - 1)) < sizeof(t_block))
+		return (0);
+	block = (t_block *)((char *)ptr - sizeof(t_block));
+	if ((!BLOCK_IS(block->tag, BLOCK_TINY)
+			&& !BLOCK_IS(block->tag, BLOCK_SMALL))
+		|| block->free)
+		return (0);
+	slot = get_slot(0, block->size);
+	if (!slot)
+		return (0);
+	__atomic_fetch_or(&block->tag, BLOCK_CACHED, __ATOMIC_RELAXED);
+	ret = -1;
+	while (ret < 0)
+	{
+		cpu = __atomic_load_n(&rs->cpu_id_start, __ATOMIC_RELAXED);
+		if ((size_t)cpu >= g_malloc.percpu.ncpus)
+			ret = 0;
+		else
+			ret = rseq_push(rs, get_slot(cpu, block->size), cpu, ptr);
+	}
+	if (!ret)
+		uncache(ptr);
+	return (ret);
+}
+
+int	percpu_cpu(void)
+{
+	if (!&__rseq_size || __rseq_size == 0)
+		return (0);
+	return (__atomic_load_n(&get_rseq()->cpu_id_start, __ATOMIC_RELAXED));
+}
+
+#else
+
+void	percpu_init(void)
+{
+	g_malloc.percpu.state = -1;
+}
+
+void	*percpu_malloc(size_t size)
+{
+	(void)size;
+	return (NULL);
+}
+
+int	percpu_free(void *ptr)
+{
+	(void)ptr;
+	return (0);
+}
+
+void	percpu_drain(void)
+{
+}
+
+int	percpu_cpu(void)
+{
+	return (0);
+}
+
+#endif
@@ -0,0 +1,203 @@
+#define _GNU_SOURCE
+#include "malloc.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+// A persistent heap is one zone laid over a shared file mapping. Its block
+// links are plain pointers, so the file must come back at the address it
+// was created at: pheap_open maps it there with MAP_FIXED_NOREPLACE and
+// fails rather than relocate. The block list is only walked and checked by
+// the first pheap_malloc or pheap_free after opening.
+
+static t_pheap	*get_pheap(t_zone *zone)
+{
+	return ((t_pheap *)((char *)zone + ZONE_OVERHEAD(0)));
+}
+
+static t_zone	*pheap_map(int fd, size_t size, void *base)
+{
+	char	*map;
+	int		flags;
+
+	flags = MAP_SHARED;
+	if (base)
+		flags |= MAP_FIXED_NOREPLACE;
+	map = mmap(base, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+	if (map == MAP_FAILED)
+		return (NULL);
+	if (base && map != base)
+	{
+		munmap(map, size);
+		return (NULL);
+	}
+	memlimit_map(size);
+	return ((t_zone *)map);
+}
+
+static t_pheap	*pheap_format(int fd, size_t size, void *base)
+{
+	t_zone	*zone;
+	t_pheap	*heap;
+	size_t	header;
+
+	header = (sizeof(t_pheap) + 15) & ~15;
+	if (size < ZONE_OVERHEAD(0) + header + sizeof(t_block) + 16)
+		size = ZONE_OVERHEAD(0) + header + sizeof(t_block) + 16;
+	size = (size + getpagesize() - 1) & ~((size_t)getpagesize() - 1);
+	if (ftruncate(fd, size))
+		return (NULL);
+	zone = pheap_map(fd, size, base);
+	if (!zone)
+		return (NULL);
+	init_zone((char *)zone, size, 0);
+	zone->blocks->tag = BLOCK_MAGIC | BLOCK_PHEAP;
+	split_block(zone->blocks, header);
+	zone->blocks->free = 0;
+	heap = get_pheap(zone);
+	heap->magic = PHEAP_MAGIC;
+	heap->version = PHEAP_VERSION;
+	heap->zone = zone;
+	heap->size = size;
+	heap->root = NULL;
+	heap->fd = fd;
+	heap->state = 1;
+	return (heap);
+}
+
+static t_pheap	*pheap_remap(int fd, size_t size)
+{
+	t_pheap	saved;
+	t_zone	*zone;
+	t_pheap	*heap;
+
+	if (pread(fd, &saved, sizeof(saved), ZONE_OVERHEAD(0)) != sizeof(saved)
+		|| saved.magic != PHEAP_MAGIC || saved.version != PHEAP_VERSION
+		|| saved.size != size || !saved.zone)
+		return (NULL);
+	zone = pheap_map(fd, size, saved.zone);
+	if (!zone)
+		return (NULL);
+	heap = get_pheap(zone);
+	heap->fd = fd;
+	heap->state = 0;
+	return (heap);
+}
+
+t_pheap	*pheap_open(const char *path, size_t size, void *base)
+{
+	struct stat	st;
+	t_pheap		*heap;
+	int			fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return (NULL);
+	if (fstat(fd, &st))
+		heap = NULL;
+	else if (st.st_size == 0)
+		heap = pheap_format(fd, size, base);
+	else
+		heap = pheap_remap(fd, st.st_size);
+	if (!heap)
+		close(fd);
+	return (heap);
+}
+
+static int	pheap_valid(t_pheap *heap)
+{
+	t_block	*block;
+	t_block	*prev;
+	char	*end;
+
+	if (heap->state)
+		return (heap->state > 0);
+	heap->state = -1;
+	end = (char *)heap->zone + heap->size;
+	prev = NULL;
+	block = heap->zone->blocks;
+	while (block)
+	{
+		if ((char *)block < (char *)heap->zone
+			|| (size_t)(end - (char *)block) < sizeof(t_block)
+			|| block->size > (size_t)(end - (char *)block) - sizeof(t_block)
+			|| block->tag != (BLOCK_MAGIC | BLOCK_PHEAP) || block->prev != prev
+			|| (!block->next && (char *)block + sizeof(t_block) + block->size
+				!= end) || (block->next && (char *)block->next
+				!= (char *)block + sizeof(t_block) + block->size))
+			return (0);
+		prev = block;
+		block = block->next;
+	}
+	heap->state = 1;
+	return (1);
+}
+
+void	*pheap_malloc(t_pheap *heap, size_t size)
+{
+	t_block	*block;
+
+	if (!heap || size == 0 || size > MALLOC_MAX_REQUEST
+		|| !pheap_valid(heap))
+		return (NULL);
+	size = align_size(size);
+	block = find_zone_block(heap->zone, size);
+	if (!block)
+		return (NULL);
+	split_block(block, size);
+	block->free = 0;
+	return ((void *)((char *)block + sizeof(t_block)));
+}
+
+void	pheap_free(t_pheap *heap, void *ptr)
+{
+	t_block	*block;
+
+	if (!heap || !ptr || ptr == (void *)heap || !pheap_valid(heap)
+		|| (char *)ptr < (char *)heap->zone->blocks + sizeof(t_block)
+		|| (char *)ptr >= (char *)heap->zone + heap->size)
+		return ;
+	block = (t_block *)((char *)ptr - sizeof(t_block));
+	if (block->tag != (BLOCK_MAGIC | BLOCK_PHEAP) || block->free)
+		return ;
+	block->free = 1;
+	merge_blocks(block);
+	if (block->prev && block->prev->free)
+		merge_blocks(block->prev);
+}
+
+void	pheap_set_root(t_pheap *heap, void *root)
+{
+	if (heap)
+		heap->root = root;
+}
+
+void	*pheap_get_root(t_pheap *heap)
+{
+	if (!heap)
+		return (NULL);
+	return (heap->root);
+}
+
+int	pheap_sync(t_pheap *heap)
+{
+	if (!heap)
+		return (-1);
+	return (msync(heap->zone, heap->size, MS_SYNC));
+}
+
+void	pheap_close(t_pheap *heap)
+{
+	t_zone	*zone;
+	size_t	size;
+	int		fd;
+
+	if (!heap)
+		return ;
+	zone = heap->zone;
+	size = heap->size;
+	fd = heap->fd;
+	msync(zone, size, MS_SYNC);
+	munmap(zone, size);
+	memlimit_unmap(size);
+	close(fd);
+}
@@ -2,9 +2,12 @@
 
 void	*realloc(void *ptr, size_t size)
 {
+	t_lock	*lock;
 	t_block	*block;
+	t_zone	*zone;
 	void	*new_ptr;
 	size_t	copy_size;
+	size_t	request;
 
 	if (!ptr)
 		return (malloc(size));
@@ -13,31 +16,44 @@ void	*realloc(void *ptr, size_t size)
 		free(ptr);
 		return (NULL);
 	}
-	pthread_mutex_lock(&g_malloc.mutex);
-	block = get_block_from_ptr(ptr);
-	if (!block)
-	{
-		pthread_mutex_unlock(&g_malloc.mutex);
+	if (size > MALLOC_MAX_REQUEST)
 		return (NULL);
-	}
+	lock = lock_block_from_ptr(ptr, &block, &zone);
+	if (!lock)
+		return (NULL);
+	request = size;
 	size = align_size(size);
 	if (block->size >= size)
 	{
-		pthread_mutex_unlock(&g_malloc.mutex);
+		block_set_slack(block, request);
+		lock_release(lock);
 		return (ptr);
 	}
+#ifdef MALLOC_TLSF
+	if (!zone)
+	{
+		if (tlsf_extend(block, size))
+		{
+			block_set_slack(block, request);
+			lock_release(lock);
+			return (ptr);
+		}
+	}
+	else
+#endif
 	if (block->next && block->next->free &&
 		block->size + sizeof(t_block) + block->next->size >= size)
 	{
-		merge_blocks(block);
-		pthread_mutex_unlock(&g_malloc.mutex);
+		zone_absorb_next(zone, block);
+		block_set_slack(block, request);
+		lock_release(lock);
 		return (ptr);
 	}
-	pthread_mutex_unlock(&g_malloc.mutex);
+	copy_size = block->size < size ? block->size : size;
+	lock_release(lock);
 	new_ptr = malloc(size);
 	if (!new_ptr)
 		return (NULL);
-	copy_size = block->size < size ? block->size : size;
 	for (size_t i = 0; i < copy_size; i++)
 		((char *)new_ptr)[i] = ((char *)ptr)[i];
 	free(ptr);
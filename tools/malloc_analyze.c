@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "malloc.h"
+
+// Offline analysis of a malloc_dump snapshot.
+// Build with `make malloc-analyze`, then run `./malloc_analyze <dump>`.
+
+#define NCLASSES 6
+#define MAX_PINNED 10
+
+typedef struct {
+    size_t zones;
+    size_t mapped;
+    size_t metadata;
+    size_t live_blocks;
+    size_t live_bytes;
+    size_t requested;
+    size_t align_pad;
+    size_t remnant;
+    size_t unknown_slack;
+    size_t free_bytes;
+    size_t cached_bytes;
+    size_t largest_free;
+    size_t free_pages;
+    size_t pinned_zones;
+    size_t pinned_mapped;
+    size_t pinned_live;
+} t_class_stats;
+
+typedef struct {
+    size_t addr;
+    size_t size;
+    size_t live;
+    unsigned int class;
+} t_pinned;
+
+typedef struct {
+    const char *name;
+    size_t bytes;
+} t_saving;
+
+static const char *g_names[NCLASSES] = { "TINY", "SMALL", "LARGE", "TLSF", "SPAN", "OTHER" };
+static t_dump_header g_header;
+static size_t *g_requests;
+static size_t g_nrequests;
+
+static int class_slot(unsigned int class) {
+    if (class >= BLOCK_TINY && class <= BLOCK_LARGE)
+        return class - BLOCK_TINY;
+    if (class == BLOCK_TLSF)
+        return 3;
+    if (class == DUMP_CLASS_SPAN)
+        return 4;
+    return 5;
+}
+
+static size_t round_page(size_t n) {
+    return (n + g_header.pagesize - 1) & ~(g_header.pagesize - 1);
+}
+
+// Mirrors align_size for the settings the dump was taken with
+static size_t align_request(size_t size, int isolate) {
+    if (isolate)
+        return ((size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1))
+               + CACHE_LINE_SIZE - g_header.block_header;
+    return (size + 15) & ~(size_t)15;
+}
+
+static size_t free_pages(size_t start, size_t size) {
+    size_t first = round_page(start + 16);
+    size_t last = (start + size) & ~(g_header.pagesize - 1);
+    return last > first ? last - first : 0;
+}
+
+// Bytes mapped if the live requests were packed into zones with the given
+// class boundaries; zone sizes scale with the boundary like the defaults.
+static size_t simulate(size_t tiny_max, size_t small_max, int isolate) {
+    size_t tiny_zone = round_page(g_header.tiny_zone * tiny_max / g_header.tiny_max);
+    size_t small_zone = round_page(g_header.small_zone * small_max / g_header.small_max);
+    size_t tiny_bytes = 0, small_bytes = 0, large = 0;
+
+    for (size_t i = 0; i < g_nrequests; i++) {
+        size_t aligned = align_request(g_requests[i], isolate);
+        if (aligned <= tiny_max)
+            tiny_bytes += aligned + g_header.block_header;
+        else if (aligned <= small_max)
+            small_bytes += aligned + g_header.block_header;
+        else
+            large += round_page(aligned + g_header.zone_overhead);
+    }
+    size_t tiny_usable = tiny_zone - g_header.zone_overhead + g_header.block_header;
+    size_t small_usable = small_zone - g_header.zone_overhead + g_header.block_header;
+    return (tiny_bytes + tiny_usable - 1) / tiny_usable * tiny_zone
+           + (small_bytes + small_usable - 1) / small_usable * small_zone + large;
+}
+
+static int compare_saving(const void *a, const void *b) {
+    size_t x = ((const t_saving *)a)->bytes;
+    size_t y = ((const t_saving *)b)->bytes;
+    return (x < y) - (x > y);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <dump>\n", argv[0]);
+        return 1;
+    }
+    FILE *file = fopen(argv[1], "rb");
+    if (!file || fread(&g_header, sizeof(g_header), 1, file) != 1
+        || g_header.magic != DUMP_MAGIC || g_header.version != DUMP_VERSION) {
+        fprintf(stderr, "%s: not a malloc dump\n", argv[1]);
+        return 1;
+    }
+    g_requests = calloc(g_header.blocks + 1, sizeof(size_t));
+    if (!g_requests) {
+        fprintf(stderr, "%s: %zu blocks do not fit in memory\n", argv[1], g_header.blocks);
+        return 1;
+    }
+    t_dump_block *blocks = NULL;
+    size_t cap = 0, nread = 0;
+    t_class_stats stats[NCLASSES];
+    t_pinned pinned[MAX_PINNED];
+    size_t npinned = 0;
+    memset(stats, 0, sizeof(stats));
+
+    // Per zone: headers, padding, remnants, free space and pinning
+    size_t z;
+    for (z = 0; z < g_header.zones; z++) {
+        t_dump_zone zone;
+        if (fread(&zone, sizeof(zone), 1, file) != 1)
+            break;
+        // g_requests holds header.blocks entries: refuse zones beyond that
+        if (zone.nblocks > g_header.blocks - nread) {
+            fprintf(stderr, "%s: zone records exceed the %zu blocks in the header\n",
+                    argv[1], g_header.blocks);
+            return 1;
+        }
+        nread += zone.nblocks;
+        if (zone.nblocks > cap) {
+            cap = zone.nblocks;
+            blocks = realloc(blocks, cap * sizeof(t_dump_block));
+            if (!blocks)
+                return 1;
+        }
+        if (fread(blocks, sizeof(t_dump_block), zone.nblocks, file) != zone.nblocks)
+            break;
+        t_class_stats *cs = &stats[class_slot(zone.class)];
+        size_t live = 0, live_bytes = 0, largest = 0, payload = 0;
+        cs->zones++;
+        cs->mapped += zone.size;
+        for (size_t i = 0; i < zone.nblocks; i++) {
+            t_dump_block *b = &blocks[i];
+            payload += b->size;
+            // Parked in a per-CPU cache: neither live nor reusable by the zone
+            if (b->free == DUMP_BLOCK_CACHED) {
+                cs->cached_bytes += b->size;
+                continue;
+            }
+            if (b->free) {
+                cs->free_bytes += b->size;
+                if (b->size > largest)
+                    largest = b->size;
+                cs->free_pages += free_pages(zone.addr + b->offset
+                                             + g_header.block_header, b->size);
+                continue;
+            }
+            live++;
+            live_bytes += b->size;
+            if (b->slack >= BLOCK_SLACK_MASK >> BLOCK_SLACK_SHIFT) {
+                cs->unknown_slack++;
+                cs->requested += b->size;
+                g_requests[g_nrequests++] = b->size;
+                continue;
+            }
+            size_t request = b->size - b->slack;
+            size_t aligned = align_request(request, g_header.isolate);
+            if (aligned > b->size)
+                aligned = b->size;
+            cs->requested += request;
+            cs->align_pad += aligned - request;
+            cs->remnant += b->size - aligned;
+            g_requests[g_nrequests++] = request;
+        }
+        cs->metadata += zone.size - payload;
+        cs->live_blocks += live;
+        cs->live_bytes += live_bytes;
+        cs->largest_free += largest;
+        // A LARGE zone always holds exactly one block and spans hold none:
+        // only shared zones and pools can be pinned
+        if (live == 1 && (zone.class == BLOCK_TINY || zone.class == BLOCK_SMALL
+                          || zone.class == BLOCK_TLSF)) {
+            cs->pinned_zones++;
+            cs->pinned_mapped += zone.size;
+            cs->pinned_live += live_bytes;
+            if (npinned < MAX_PINNED)
+                pinned[npinned++] = (t_pinned){ zone.addr, zone.size, live_bytes, zone.class };
+        }
+    }
+    fclose(file);
+    if (z < g_header.zones)
+        fprintf(stderr, "%s: truncated, analyzing %zu of %zu zones\n",
+                argv[1], z, g_header.zones);
+
+    printf("%-6s %6s %12s %12s %12s %10s %10s %12s %10s %8s %8s\n", "class", "zones",
+           "mapped", "requested", "metadata", "align pad", "remnants",
+           "free", "cached", "int frag", "ext frag");
+    size_t total_mapped = 0, total_free_pages = 0, total_pinned = 0;
+    for (int c = 0; c < NCLASSES; c++) {
+        t_class_stats *cs = &stats[c];
+        if (!cs->zones)
+            continue;
+        double internal = cs->live_bytes
+            ? 100.0 * (cs->align_pad + cs->remnant) / cs->live_bytes : 0;
+        double external = cs->free_bytes
+            ? 100.0 * (1.0 - (double)cs->largest_free / cs->free_bytes) : 0;
+        printf("%-6s %6zu %12zu %12zu %12zu %10zu %10zu %12zu %10zu %7.1f%% %7.1f%%\n",
+               g_names[c], cs->zones, cs->mapped, cs->requested, cs->metadata,
+               cs->align_pad, cs->remnant, cs->free_bytes, cs->cached_bytes,
+               internal, external);
+        if (cs->unknown_slack)
+            printf("       %zu live blocks with slack over 254 bytes counted as fully used\n",
+                   cs->unknown_slack);
+        total_mapped += cs->mapped;
+        if (c != class_slot(DUMP_CLASS_SPAN))
+            total_free_pages += cs->free_pages;
+        total_pinned += cs->pinned_mapped - cs->pinned_live;
+    }
+
+    printf("\nZones pinned by a single live block:\n");
+    for (int c = 0; c < NCLASSES; c++)
+        if (stats[c].pinned_zones)
+            printf("  %-6s %zu zones, %zu bytes mapped for %zu live bytes\n", g_names[c],
+                   stats[c].pinned_zones, stats[c].pinned_mapped, stats[c].pinned_live);
+    for (size_t i = 0; i < npinned; i++)
+        printf("  0x%zx %-6s %zu bytes held by one %zu-byte block\n", pinned[i].addr,
+               g_names[class_slot(pinned[i].class)], pinned[i].size, pinned[i].live);
+    if (!npinned)
+        printf("  none\n");
+
+    // Alternative class boundaries over the same live requests
+    static const size_t tiny_options[] = { 64, 128, 256, 512 };
+    static const size_t small_options[] = { 512, 1024, 2048, 4096, 8192 };
+    size_t current = simulate(g_header.tiny_max, g_header.small_max, g_header.isolate);
+    size_t best = current, best_tiny = g_header.tiny_max, best_small = g_header.small_max;
+    printf("\nSimulated class boundaries (live requests packed into fresh zones):\n");
+    printf("  %8s %8s %12s %12s\n", "tiny", "small", "mapped", "vs current");
+    for (size_t t = 0; t < sizeof(tiny_options) / sizeof(*tiny_options); t++) {
+        for (size_t s = 0; s < sizeof(small_options) / sizeof(*small_options); s++) {
+            if (tiny_options[t] >= small_options[s])
+                continue;
+            size_t mapped = simulate(tiny_options[t], small_options[s], g_header.isolate);
+            printf("  %8zu %8zu %12zu %+12ld%s\n", tiny_options[t], small_options[s],
+                   mapped, (long)mapped - (long)current,
+                   tiny_options[t] == g_header.tiny_max && small_options[s] == g_header.small_max
+                   ? "  (current)" : "");
+            if (mapped < best) {
+                best = mapped;
+                best_tiny = tiny_options[t];
+                best_small = small_options[s];
+            }
+        }
+    }
+
+    // Rank what each setting would give back for this heap
+    t_saving savings[5];
+    int nsavings = 0;
+    char boundary_name[128];
+    snprintf(boundary_name, sizeof(boundary_name),
+             "TINY_MAX_SIZE %zu / SMALL_MAX_SIZE %zu", best_tiny, best_small);
+    savings[nsavings++] = (t_saving){ boundary_name, current - best };
+    if (g_header.isolate)
+        savings[nsavings++] = (t_saving){ "unset MALLOC_CACHELINE_ISOLATE",
+            current - simulate(g_header.tiny_max, g_header.small_max, 0) };
+    savings[nsavings++] = (t_saving){ "aggressive purge (malloc_set_soft_limit)",
+        total_free_pages };
+    savings[nsavings++] = (t_saving){ "smaller SPAN_POOL_MAX", stats[4].mapped };
+    savings[nsavings++] = (t_saving){ "move pinning objects to heaps/objcaches",
+        total_pinned };
+    qsort(savings, nsavings, sizeof(*savings), compare_saving);
+    printf("\nEstimated RSS savings (of %zu bytes mapped):\n", total_mapped);
+    for (int i = 0; i < nsavings; i++)
+        printf("  %12zu  %s\n", savings[i].bytes, savings[i].name);
+    free(blocks);
+    free(g_requests);
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
+#include "malloc.h"
+
+// Live view of a process running with MALLOC_STATS=1.
+// Build with `make malloc-top`, then run `./malloc_top <pid> [interval_ms] [count]`.
+
+typedef struct {
+    size_t allocs[3];
+    size_t frees;
+    size_t contended;
+    size_t footprint;
+    size_t zones[3];
+    size_t pools;
+    double time;
+} t_sample;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void read_sample(t_stats *stats, t_sample *out) {
+    unsigned int seq;
+    
+    // Retry the snapshot until no writer was inside while it was copied
+    do {
+        while ((seq = __atomic_load_n(&stats->seq, __ATOMIC_ACQUIRE)) & 1)
+            ;
+        out->footprint = stats->footprint;
+        memcpy(out->zones, stats->zones, sizeof(out->zones));
+        out->pools = stats->pools;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&stats->seq, __ATOMIC_RELAXED) != seq);
+    
+    memset(out->allocs, 0, sizeof(out->allocs));
+    out->frees = 0;
+    for (int i = 0; i < STATS_SHARDS; i++) {
+        for (int c = 0; c < 3; c++)
+            out->allocs[c] += __atomic_load_n(&stats->shards[i].allocs[c], __ATOMIC_RELAXED);
+        out->frees += __atomic_load_n(&stats->shards[i].frees, __ATOMIC_RELAXED);
+    }
+    out->contended = __atomic_load_n(&stats->contended, __ATOMIC_RELAXED);
+    out->time = now_sec();
+}
+
+static double rate(size_t now, size_t before, double seconds) {
+    return seconds > 0 ? (now - before) / seconds : 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <pid> [interval_ms] [count]\n", argv[0]);
+        return 1;
+    }
+    int pid = atoi(argv[1]);
+    long interval_ms = argc > 2 ? atol(argv[2]) : 1000;
+    long count = argc > 3 ? atol(argv[3]) : -1;
+    
+    char path[64];
+    snprintf(path, sizeof(path), "%s%d", STATS_PATH, pid);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "%s: no stats page (is MALLOC_STATS=1 set?)\n", path);
+        return 1;
+    }
+    t_stats *stats = mmap(NULL, sizeof(t_stats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (stats == MAP_FAILED || stats->magic != STATS_MAGIC) {
+        fprintf(stderr, "%s: not a malloc stats page\n", path);
+        return 1;
+    }
+    
+    t_sample prev, cur;
+    read_sample(stats, &prev);
+    printf("%10s %10s %10s %10s %12s %6s %6s %6s %6s %10s\n",
+           "tiny/s", "small/s", "large/s", "frees/s", "mapped",
+           "tiny", "small", "large", "pools", "waits/s");
+    while (count-- != 0 && kill(pid, 0) == 0) {
+        struct timespec ts = { interval_ms / 1000, (interval_ms % 1000) * 1000000L };
+        nanosleep(&ts, NULL);
+        read_sample(stats, &cur);
+        double dt = cur.time - prev.time;
+        printf("%10.0f %10.0f %10.0f %10.0f %12zu %6zu %6zu %6zu %6zu %10.0f\n",
+               rate(cur.allocs[0], prev.allocs[0], dt),
+               rate(cur.allocs[1], prev.allocs[1], dt),
+               rate(cur.allocs[2], prev.allocs[2], dt),
+               rate(cur.frees, prev.frees, dt), cur.footprint,
+               cur.zones[0], cur.zones[1], cur.zones[2], cur.pools,
+               rate(cur.contended, prev.contended, dt));
+        fflush(stdout);
+        prev = cur;
+    }
+    munmap(stats, sizeof(t_stats));
+    return 0;
+}